@@ -0,0 +1,162 @@
+/**
+ * @file draw_benchmark.cpp
+ * @brief Frames/sec of redrawing a cell grid with drawPoint vs Canvas::blitIndexed
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include "Canvas.hpp"
+#include "Grid.hpp"
+
+enum CellID : int32_t {
+    AIR,
+    WALL,
+    SAND,
+    WATER
+};
+
+struct Coord {
+    int32_t x = 0;
+    int32_t y = 0;
+    Coord(int32_t x = 0, int32_t y = 0) : x(x), y(y) {}
+};
+
+struct Color {
+    uint8_t r = 0;
+    uint8_t g = 0;
+    uint8_t b = 0;
+    uint8_t a = 255;
+    Color(uint8_t r = 0, uint8_t g = 0, uint8_t b = 0, uint8_t a = 255) : r(r), g(g), b(b), a(a) {}
+};
+
+// the per pixel path of R2DEngine and App before the bulk drawing calls
+struct LegacyRenderer {
+    int32_t innerWidth;
+    int32_t innerHeight;
+    std::vector<uint8_t> bufferData;
+
+    LegacyRenderer(int32_t width, int32_t height) : innerWidth(width), innerHeight(height), bufferData(width * height * 4) {}
+
+    void drawPoint(Coord coord, Color color) {
+        if (0 <= coord.x && coord.x < innerWidth && 0 <= coord.y && coord.y < innerHeight) {
+            bufferData[coord.y * innerWidth * 4 + coord.x * 4 + 0] = color.r;
+            bufferData[coord.y * innerWidth * 4 + coord.x * 4 + 1] = color.g;
+            bufferData[coord.y * innerWidth * 4 + coord.x * 4 + 2] = color.b;
+            bufferData[coord.y * innerWidth * 4 + coord.x * 4 + 3] = color.a;
+        }
+    }
+
+    void draw(const Grid<CellID>& map) {
+        memset(bufferData.data(), 0, bufferData.size());
+        for (int32_t y = 0; y < map.height(); y ++) {
+            for (int32_t x = 0; x < map.width(); x ++) {
+                switch (map[y][x]) {
+                    case WALL: {
+                        drawPoint({x, y}, {200, 200, 200});
+                        break;
+                    }
+                    case SAND: {
+                        drawPoint({x, y}, {200, 200, 50});
+                        break;
+                    }
+                    case WATER: {
+                        drawPoint({x, y}, {0, 255, 255});
+                        break;
+                    }
+                    default: {
+                        break;
+                    }
+                }
+            }
+        }
+    }
+};
+
+struct CanvasRenderer {
+    std::vector<uint8_t> bufferData;
+    Canvas canvas;
+    uint32_t palette[4];
+
+    CanvasRenderer(int32_t width, int32_t height) : bufferData(width * height * 4) {
+        canvas = Canvas(bufferData.data(), width, height);
+        palette[AIR] = Canvas::rgba(0, 0, 0, 0);
+        palette[WALL] = Canvas::rgba(200, 200, 200);
+        palette[SAND] = Canvas::rgba(200, 200, 50);
+        palette[WATER] = Canvas::rgba(0, 255, 255);
+    }
+
+    void draw(const Grid<CellID>& map) {
+        const int32_t* indices = reinterpret_cast<const int32_t*>(map[0]);
+        canvas.blitIndexed(0, 0, map.width(), map.height(), indices, map.stride(), palette, 4);
+    }
+};
+
+void seed(Grid<CellID>& map) {
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> pick(0, 9);
+    for (int y = 0; y < map.height(); y ++) {
+        for (int x = 0; x < map.width(); x ++) {
+            // about half air, like a scene in progress
+            int r = pick(rng);
+            map[y][x] = r < 5 ? AIR : r < 6 ? WALL : r < 8 ? SAND : WATER;
+        }
+    }
+}
+
+template <typename Renderer>
+double run(const Grid<CellID>& map, int frames, std::vector<uint8_t>& result) {
+    Renderer renderer(map.width(), map.height());
+    renderer.draw(map);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i ++) {
+        renderer.draw(map);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    result = renderer.bufferData;
+    return frames / std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char** argv) {
+    const int sizes[][2] = {
+        {160, 120},
+        {1920, 1080},
+        {3840, 2160}
+    };
+    // roughly the same number of pixels drawn for every size
+    double budget = argc > 1 ? atof(argv[1]) : 5e8;
+
+    printf("%-12s %8s %14s %14s %8s %s\n", "size", "frames", "drawPoint", "blitIndexed", "speedup", "image");
+    for (const auto& size : sizes) {
+        int width = size[0];
+        int height = size[1];
+        int frames = std::max(3, static_cast<int>(budget / (static_cast<double>(width) * height)));
+
+        Grid<CellID> map(width, height, AIR);
+        seed(map);
+
+        std::vector<uint8_t> legacyImage;
+        std::vector<uint8_t> canvasImage;
+        double legacy = run<LegacyRenderer>(map, frames, legacyImage);
+        double canvas = run<CanvasRenderer>(map, frames, canvasImage);
+
+        char label[32];
+        snprintf(label, sizeof(label), "%dx%d", width, height);
+        printf("%-12s %8d %14.1f %14.1f %7.2fx %s\n", label, frames, legacy, canvas, canvas / legacy,
+            legacyImage == canvasImage ? "match" : "MISMATCH");
+    }
+    return 0;
+}
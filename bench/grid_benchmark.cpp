@@ -0,0 +1,336 @@
+/**
+ * @file grid_benchmark.cpp
+ * @brief Ticks/sec of the sand tick on vector-of-vectors vs Grid<T> storage
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include "Grid.hpp"
+
+enum CellID {
+    AIR,
+    WALL,
+    SAND,
+    WATER
+};
+
+const float maxMass = 1.0;
+const float maxCompress = 0.02;
+const float minMass = 0.001;
+const float minFlow = 0.01;
+const float maxSpeed = 1.0;
+
+// the cell rules of App, shared by both storage layouts
+template <typename CellMap, typename MassMap>
+struct Rules {
+    CellMap map;
+    CellMap mapBuffer;
+    MassMap mass;
+    MassMap massBuffer;
+
+    void update_wall(int x, int y) {
+        mapBuffer[y][x] = WALL;
+    }
+
+    void update_sand(int x, int y) {
+        if (map[y + 1][x] != SAND && map[y + 1][x] != WALL) {
+            mapBuffer[y + 1][x] = SAND;
+            map[y][x] = map[y + 1][x];
+        } else if (map[y + 1][x - 1] != SAND && map[y + 1][x - 1] != WALL) {
+            mapBuffer[y + 1][x - 1] = SAND;
+            map[y][x] = map[y + 1][x - 1];
+        } else if (map[y + 1][x + 1] != SAND && map[y + 1][x + 1] != WALL) {
+            mapBuffer[y + 1][x + 1] = SAND;
+            map[y][x] = map[y + 1][x + 1];
+        } else {
+            mapBuffer[y][x] = SAND;
+        }
+    }
+
+    float calcFlow(float totalMass) {
+        if (totalMass <= 1.0) {
+            return 1;
+        } else if (totalMass < 2 * maxMass + maxCompress) {
+            return (maxMass * maxMass + totalMass * maxCompress) / (maxMass + maxCompress);
+        } else {
+            return (totalMass + maxCompress) / 2;
+        }
+    }
+
+    inline float constrain(float x, float min, float max) {
+        if (x < min) {
+            return min;
+        } else if (x > max) {
+            return max;
+        } else {
+            return x;
+        }
+    }
+
+    void update_water(int x, int y) {
+        float flow = 0.0;
+        float remainingMass = mass[y][x];
+        if (remainingMass <= 0.0) return;
+
+        if (map[y + 1][x] == AIR || map[y + 1][x] == WATER) {
+            flow = calcFlow(remainingMass + mass[y + 1][x]) - mass[y + 1][x];
+            if (flow > minFlow) {
+                flow *= 0.5;
+            }
+            flow = constrain(flow, 0, std::min(maxSpeed, remainingMass));
+            massBuffer[y][x] -= flow;
+            massBuffer[y + 1][x] += flow;
+            remainingMass -= flow;
+        }
+
+        if (remainingMass <= 0.0) return;
+
+        if (map[y][x + 1] == AIR || map[y][x + 1] == WATER) {
+            flow = (mass[y][x] - mass[y][x + 1]) / 4.0;
+            if (flow > minFlow) {
+                flow *= 0.5;
+            }
+            flow = constrain(flow, 0, remainingMass);
+            massBuffer[y][x] -= flow;
+            massBuffer[y][x + 1] += flow;
+            remainingMass -= flow;
+        }
+
+        if (remainingMass <= 0.0) return;
+
+        if (map[y][x - 1] == AIR || map[y][x - 1] == WATER) {
+            flow = (mass[y][x] - mass[y][x - 1]) / 4.0;
+            if (flow > minFlow) {
+                flow *= 0.5;
+            }
+            flow = constrain(flow, 0, remainingMass);
+            massBuffer[y][x] -= flow;
+            massBuffer[y][x - 1] += flow;
+            remainingMass -= flow;
+        }
+
+        if (remainingMass <= 0.0) return;
+
+        if (map[y - 1][x] == AIR || map[y - 1][x] == WATER) {
+            flow = remainingMass - calcFlow(remainingMass + mass[y - 1][x]);
+            if (flow > minFlow) {
+                flow *= 0.5;
+            }
+            flow = constrain(flow, 0, std::min(maxSpeed, remainingMass));
+            massBuffer[y][x] -= flow;
+            massBuffer[y - 1][x] += flow;
+            remainingMass -= flow;
+        }
+    }
+
+    void update(CellID id, int x, int y) {
+        switch (id) {
+            case AIR: {
+                break;
+            }
+            case WALL: {
+                update_wall(x, y);
+                break;
+            }
+            case SAND: {
+                update_sand(x, y);
+                break;
+            }
+            case WATER: {
+                update_water(x, y);
+                break;
+            }
+        }
+    }
+};
+
+// the tick as it was written against std::vector<std::vector<...>>
+struct LegacyWorld : Rules<std::vector<std::vector<CellID>>, std::vector<std::vector<float>>> {
+    int width;
+    int height;
+
+    LegacyWorld(int width, int height) : width(width), height(height) {
+        map.assign(height, std::vector<CellID>(width, AIR));
+        mapBuffer.assign(height, std::vector<CellID>(width, AIR));
+        mass.assign(height, std::vector<float>(width, 0.0));
+        massBuffer.assign(height, std::vector<float>(width, 0.0));
+    }
+
+    void set(int x, int y, CellID id, float m) {
+        map[y][x] = id;
+        mass[y][x] = m;
+    }
+
+    CellID get(int x, int y) const {
+        return map[y][x];
+    }
+
+    float getMass(int x, int y) const {
+        return mass[y][x];
+    }
+
+    void tick() {
+        for (int y = 0; y < height; y ++) {
+            for (int x = 0; x < width; x ++) {
+                mapBuffer[y][x] = AIR;
+                massBuffer[y][x] = mass[y][x];
+            }
+        }
+        for (int y = height - 1; y >= 0; y --) {
+            for (int x = 0; x < width; x ++) {
+                update(map[y][x], x, y);
+            }
+        }
+        for (int y = 0; y < height; y ++) {
+            for (int x = 0; x < width; x ++) {
+                mass[y][x] = massBuffer[y][x];
+                if (mapBuffer[y][x] == WALL || mapBuffer[y][x] == SAND) continue;
+                if (mass[y][x] > minMass) {
+                    mapBuffer[y][x] = WATER;
+                }
+            }
+        }
+        for (int y = 0; y < height; y ++) {
+            for (int x = 0; x < width; x ++) {
+                map[y][x] = mapBuffer[y][x];
+            }
+        }
+    }
+};
+
+// the same tick on Grid<T>
+struct GridWorld : Rules<Grid<CellID>, Grid<float>> {
+    int width;
+    int height;
+
+    GridWorld(int width, int height) : width(width), height(height) {
+        map = Grid<CellID>(width, height, AIR);
+        mapBuffer = Grid<CellID>(width, height, AIR);
+        mass = Grid<float>(width, height, 0.0);
+        massBuffer = Grid<float>(width, height, 0.0);
+        map.fillHalo(WALL);
+        mapBuffer.fillHalo(WALL);
+    }
+
+    void set(int x, int y, CellID id, float m) {
+        map[y][x] = id;
+        mass[y][x] = m;
+    }
+
+    CellID get(int x, int y) const {
+        return map[y][x];
+    }
+
+    float getMass(int x, int y) const {
+        return mass[y][x];
+    }
+
+    void tick() {
+        mapBuffer.fill(AIR);
+        massBuffer.copyFrom(mass);
+        for (int y = height - 1; y >= 0; y --) {
+            const CellID* row = map[y];
+            for (int x = 0; x < width; x ++) {
+                update(row[x], x, y);
+            }
+        }
+        mass.swap(massBuffer);
+        for (int y = 0; y < height; y ++) {
+            CellID* row = mapBuffer[y];
+            const float* rowMass = mass[y];
+            for (int x = 0; x < width; x ++) {
+                if (row[x] == WALL || row[x] == SAND) continue;
+                if (rowMass[x] > minMass) {
+                    row[x] = WATER;
+                }
+            }
+        }
+        map.swap(mapBuffer);
+    }
+};
+
+// walls on every border, a sand layer in the upper half and a water tank below it
+template <typename World>
+void seed(World& world, int width, int height) {
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> dist(0.0, 1.0);
+    for (int y = 0; y < height; y ++) {
+        for (int x = 0; x < width; x ++) {
+            if (y == 0 || y == height - 1 || x == 0 || x == width - 1) {
+                world.set(x, y, WALL, 0.0);
+            } else if (y < height / 2) {
+                if (dist(rng) < 0.3) {
+                    world.set(x, y, SAND, 0.0);
+                }
+            } else if (y > height * 3 / 4) {
+                world.set(x, y, WATER, 1.0);
+            }
+        }
+    }
+}
+
+template <typename World>
+uint64_t checksum(const World& world, int width, int height) {
+    uint64_t hash = 1469598103934665603ull;
+    for (int y = 0; y < height; y ++) {
+        for (int x = 0; x < width; x ++) {
+            hash = (hash ^ static_cast<uint64_t>(world.get(x, y))) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+template <typename World>
+double run(int width, int height, int ticks, uint64_t& hash) {
+    World world(width, height);
+    seed(world, width, height);
+    world.tick();
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ticks; i ++) {
+        world.tick();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    hash = checksum(world, width, height);
+    return ticks / std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char** argv) {
+    const int sizes[][2] = {
+        {160, 120},
+        {1024, 1024},
+        {4096, 4096}
+    };
+    // roughly the same number of cell updates for every size
+    double budget = argc > 1 ? atof(argv[1]) : 2e8;
+
+    printf("%-12s %8s %14s %14s %8s %s\n", "size", "ticks", "vector<vector>", "Grid<T>", "speedup", "state");
+    for (const auto& size : sizes) {
+        int width = size[0];
+        int height = size[1];
+        int ticks = std::max(3, static_cast<int>(budget / (static_cast<double>(width) * height)));
+
+        uint64_t legacyHash = 0;
+        uint64_t gridHash = 0;
+        double legacy = run<LegacyWorld>(width, height, ticks, legacyHash);
+        double grid = run<GridWorld>(width, height, ticks, gridHash);
+
+        char label[32];
+        snprintf(label, sizeof(label), "%dx%d", width, height);
+        printf("%-12s %8d %14.1f %14.1f %7.2fx %s\n", label, ticks, legacy, grid, grid / legacy,
+            legacyHash == gridHash ? "match" : "MISMATCH");
+    }
+    return 0;
+}
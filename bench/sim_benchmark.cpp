@@ -0,0 +1,363 @@
+/**
+ * @file sim_benchmark.cpp
+ * @brief Google Benchmark suite of the cell rules, the tick and drawing across sizes and scenes
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#include <cstdint>
+#include <initializer_list>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "Brush.hpp"
+#include "Camera.hpp"
+#include "Canvas.hpp"
+#include "Scenes.hpp"
+#include "Simulation.hpp"
+
+/*
+Every benchmark but calcFlow runs on square worlds of 256, 1024 and 2048
+cells seeded with one of the scenes of Scenes.hpp (empty, sand pile, water
+tank, mixed, materials), the scene is the second argument and the label.
+
+update_sand, update_water   one pass of the rule over every cell of its
+                            material, in sweep order, on a fresh world of
+                            a scene that has the material; update_sand
+                            runs the powder rule over every powder of the
+                            materials scene
+calcFlow                    the water flow curve over random masses
+tick                        Simulation::tick(), the world is restored
+                            every restoreTicks ticks so runs of different
+                            lengths see the same states
+tickColored                 a tick plus coloring what it changed, either
+                            fused into the commit (fused 1) or by
+                            blitIndexed() over the dirty rects afterwards
+drawPoint, blitIndexed      coloring the whole world cell by cell the way
+                            the engine's drawPoint() does, and in bulk
+viewDraw                    drawing a 1280 x 720 camera viewport of the
+                            colored world at zoom 0 and zoomed out 8x, the
+                            cost must not grow with the world
+brushStroke                 painting a stroke of a brush radius across a
+                            1024 world, rasterized and written a row at a
+                            time (batched 1) or cell by cell with set()
+
+Items per second are cells for the rules and the drawing and ticks for
+the tick. For tracking regressions write JSON, e.g.
+
+    sim_benchmark --benchmark_format=json --benchmark_out=sim.json
+*/
+
+// restores the world, and calls the private rules of Simulation
+struct RuleBenchmark {
+    static constexpr int32_t restoreTicks = 32;
+
+    static Simulation world(int32_t size, Scene scene) {
+        Simulation sim(size, size);
+        seedScene(sim, scene, 1);
+        return sim;
+    }
+
+    static void restore(Simulation& sim, const Grid<Cell>& cells) {
+        sim.assignRows(0, cells.height(), cells[0], cells.stride());
+    }
+
+    static int64_t count(const Simulation& sim, Materials::Rule rule) {
+        int64_t cells = 0;
+        for (int32_t y = 0; y < sim.height(); y ++) {
+            for (int32_t x = 0; x < sim.width(); x ++) {
+                cells += Materials::lookup.rule[sim.get(x, y)] == rule;
+            }
+        }
+        return cells;
+    }
+
+    // rule over every cell of a material with it, bottom row first like the serial sweep
+    static void pass(Simulation& sim, Materials::Rule rule) {
+        for (int32_t y = sim.h - 1; y >= 0; y --) {
+            for (int32_t x = 0; x < sim.w; x ++) {
+                if (Materials::lookup.rule[sim.map[y][x].type] != rule) {
+                    continue;
+                }
+                if (rule == Materials::Rule::POWDER) {
+                    sim.update_powder(x, y);
+                } else {
+                    sim.update_water(x, y);
+                }
+            }
+        }
+    }
+};
+
+namespace {
+
+Scene sceneArg(const benchmark::State& state) {
+    return static_cast<Scene>(state.range(1));
+}
+
+void rule(benchmark::State& state, Materials::Rule id) {
+    Simulation sim = RuleBenchmark::world(static_cast<int32_t>(state.range(0)), sceneArg(state));
+    Grid<Cell> fresh = sim.cells();
+    int64_t cells = RuleBenchmark::count(sim, id);
+    for (auto _ : state) {
+        RuleBenchmark::pass(sim, id);
+        benchmark::ClobberMemory();
+        state.PauseTiming();
+        RuleBenchmark::restore(sim, fresh);
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * cells);
+    state.SetLabel(sceneName(sceneArg(state)));
+}
+
+void BM_UpdateSand(benchmark::State& state) {
+    rule(state, Materials::Rule::POWDER);
+}
+
+void BM_UpdateWater(benchmark::State& state) {
+    rule(state, Materials::Rule::WATER);
+}
+
+void BM_CalcFlow(benchmark::State& state) {
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> dist(0.0f, 2.0f * Simulation::maxMass + 0.1f);
+    std::vector<float> totals(static_cast<size_t>(state.range(0)));
+    for (float& total : totals) {
+        total = dist(rng);
+    }
+    for (auto _ : state) {
+        for (float total : totals) {
+            benchmark::DoNotOptimize(Simulation::calcFlow(total));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void BM_Tick(benchmark::State& state) {
+    Simulation sim = RuleBenchmark::world(static_cast<int32_t>(state.range(0)), sceneArg(state));
+    Grid<Cell> fresh = sim.cells();
+    uint64_t first = sim.tickCount();
+    int64_t ticks = 0;
+    for (auto _ : state) {
+        sim.tick();
+        if (++ ticks % RuleBenchmark::restoreTicks == 0) {
+            state.PauseTiming();
+            RuleBenchmark::restore(sim, fresh);
+            sim.setTickCount(first);
+            state.ResumeTiming();
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["cells/s"] = benchmark::Counter(static_cast<double>(sim.width()) * sim.height(),
+        benchmark::Counter::kIsIterationInvariantRate);
+    state.SetLabel(sceneName(sceneArg(state)));
+}
+
+// an empty world with a stream of sand poured into its middle, a tick should cost the
+// few chunks the stream keeps awake however large the world is
+void BM_TickSparse(benchmark::State& state) {
+    int32_t size = static_cast<int32_t>(state.range(0));
+    Simulation sim(size, size);
+    // every chunk of a new world is awake for its first tick
+    sim.tick();
+    int64_t active = 0;
+    for (auto _ : state) {
+        sim.fillRow(size / 2 - 4, 0, 8, Simulation::SAND);
+        sim.tick();
+        active += sim.activeChunks();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["chunks"] = benchmark::Counter(static_cast<double>(active), benchmark::Counter::kAvgIterations);
+}
+
+// a lake over the lower half of the world, left to settle, then a drop of water poured onto it
+// every tick if poured; the pressure model should keep only the water the drops disturb awake
+void BM_TickLake(benchmark::State& state) {
+    int32_t size = static_cast<int32_t>(state.range(0));
+    bool pressure = state.range(1) != 0;
+    bool poured = state.range(2) != 0;
+    Simulation sim(size, size);
+    sim.setWaterModel(pressure ? Simulation::WaterModel::PRESSURE : Simulation::WaterModel::MASS);
+    sim.fillRow(0, size - 1, size, Simulation::WALL);
+    for (int32_t y = size / 2; y < size - 1; y ++) {
+        sim.fillRow(0, y, size, Simulation::WATER, 1.0);
+    }
+    for (int32_t i = 0; i < 100; i ++) {
+        sim.tick();
+    }
+    int64_t active = 0;
+    for (auto _ : state) {
+        if (poured) {
+            sim.set(size / 2, 0, Simulation::WATER, 1.0);
+        }
+        sim.tick();
+        active += sim.activeChunks();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["chunks"] = benchmark::Counter(static_cast<double>(active), benchmark::Counter::kAvgIterations);
+}
+
+struct Renderer {
+    std::vector<uint32_t> pixels;
+    Canvas canvas;
+    uint32_t palette[Materials::COUNT];
+
+    explicit Renderer(int32_t size) : pixels(static_cast<size_t>(size) * size) {
+        canvas = Canvas(reinterpret_cast<uint8_t*>(pixels.data()), size, size);
+        Materials::palette(palette);
+    }
+};
+
+void BM_TickColored(benchmark::State& state) {
+    Simulation sim = RuleBenchmark::world(static_cast<int32_t>(state.range(0)), Scene::MIXED);
+    Grid<Cell> fresh = sim.cells();
+    uint64_t first = sim.tickCount();
+    bool fused = state.range(1) != 0;
+    Renderer renderer(sim.width());
+    Simulation::ColorTarget target;
+    target.pixels = renderer.pixels.data();
+    target.stride = sim.width();
+    target.palette = renderer.palette;
+    target.paletteSize = Materials::COUNT;
+    std::vector<Simulation::Rect> dirty;
+    int64_t ticks = 0;
+    for (auto _ : state) {
+        dirty.clear();
+        if (fused) {
+            sim.tick(&target);
+            sim.takeDirtyRects(dirty);
+        } else {
+            sim.tick();
+            sim.takeDirtyRects(dirty);
+            const Grid<Cell>& cells = sim.cells();
+            for (const Simulation::Rect& rect : dirty) {
+                renderer.canvas.blitIndexed(rect.x, rect.y, rect.w, rect.h, reinterpret_cast<const int32_t*>(cells[rect.y] + rect.x),
+                    cells.stride(), renderer.palette, Materials::COUNT, 0xff);
+            }
+        }
+        benchmark::ClobberMemory();
+        if (++ ticks % RuleBenchmark::restoreTicks == 0) {
+            state.PauseTiming();
+            RuleBenchmark::restore(sim, fresh);
+            sim.setTickCount(first);
+            state.ResumeTiming();
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void BM_DrawPoint(benchmark::State& state) {
+    Simulation sim = RuleBenchmark::world(static_cast<int32_t>(state.range(0)), sceneArg(state));
+    Renderer renderer(sim.width());
+    for (auto _ : state) {
+        for (int32_t y = 0; y < sim.height(); y ++) {
+            for (int32_t x = 0; x < sim.width(); x ++) {
+                renderer.canvas.point(x, y, renderer.palette[sim.get(x, y)]);
+            }
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * sim.width() * sim.height());
+    state.SetLabel(sceneName(sceneArg(state)));
+}
+
+void BM_BlitIndexed(benchmark::State& state) {
+    Simulation sim = RuleBenchmark::world(static_cast<int32_t>(state.range(0)), sceneArg(state));
+    Renderer renderer(sim.width());
+    const Grid<Cell>& cells = sim.cells();
+    for (auto _ : state) {
+        renderer.canvas.blitIndexed(0, 0, cells.width(), cells.height(), reinterpret_cast<const int32_t*>(cells[0]),
+            cells.stride(), renderer.palette, Materials::COUNT, 0xff);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * sim.width() * sim.height());
+    state.SetLabel(sceneName(sceneArg(state)));
+}
+
+void BM_ViewDraw(benchmark::State& state) {
+    Simulation sim = RuleBenchmark::world(static_cast<int32_t>(state.range(0)), Scene::MIXED);
+    Renderer renderer(sim.width());
+    const Grid<Cell>& cells = sim.cells();
+    renderer.canvas.blitIndexed(0, 0, cells.width(), cells.height(), reinterpret_cast<const int32_t*>(cells[0]),
+        cells.stride(), renderer.palette, Materials::COUNT, 0xff);
+    WorldView view;
+    view.setWorld(renderer.pixels.data(), sim.width(), sim.height());
+    Camera camera(1280, 720);
+    camera.lookAt(sim.width() * 0.5, sim.height() * 0.5);
+    camera.zoomBy(static_cast<int32_t>(state.range(1)), 640.0, 360.0);
+    std::vector<uint32_t> viewport(1280 * 720);
+    for (auto _ : state) {
+        view.draw(camera, viewport.data(), 1280, 0);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * 1280 * 720);
+}
+
+void BM_BrushStroke(benchmark::State& state) {
+    Simulation sim(1024, 1024);
+    Brush brush;
+    brush.radius = static_cast<int32_t>(state.range(0));
+    bool batched = state.range(1) != 0;
+    std::vector<BrushSpan> spans;
+    int64_t cells = 0;
+    for (auto _ : state) {
+        spans.clear();
+        rasterizeStroke(brush, 100, 200, 900, 700, sim.width(), sim.height(), spans);
+        for (const BrushSpan& span : spans) {
+            if (batched) {
+                sim.fillRow(span.x, span.y, span.length, brush.material);
+            } else {
+                for (int32_t x = span.x; x < span.x + span.length; x ++) {
+                    sim.set(x, span.y, brush.material);
+                }
+            }
+            cells += span.length;
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(cells);
+}
+
+void addWorlds(benchmark::internal::Benchmark* benchmark, std::initializer_list<Scene> scenes) {
+    benchmark->ArgNames({"size", "scene"});
+    for (int64_t size : {256, 1024, 2048}) {
+        for (Scene scene : scenes) {
+            benchmark->Args({size, static_cast<int64_t>(scene)});
+        }
+    }
+}
+
+void worlds(benchmark::internal::Benchmark* benchmark) {
+    addWorlds(benchmark, {Scene::EMPTY, Scene::SAND, Scene::WATER, Scene::MIXED, Scene::MATERIALS});
+}
+
+// a rule is only timed on scenes that have its material
+void sandWorlds(benchmark::internal::Benchmark* benchmark) {
+    addWorlds(benchmark, {Scene::SAND, Scene::MIXED, Scene::MATERIALS});
+}
+
+void waterWorlds(benchmark::internal::Benchmark* benchmark) {
+    addWorlds(benchmark, {Scene::WATER, Scene::MIXED, Scene::MATERIALS});
+}
+
+}
+
+BENCHMARK(BM_UpdateSand)->Apply(sandWorlds)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_UpdateWater)->Apply(waterWorlds)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_CalcFlow)->Arg(1 << 16);
+BENCHMARK(BM_Tick)->Apply(worlds)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_TickSparse)->ArgName("size")->Arg(1024)->Arg(4096)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_TickLake)->ArgNames({"size", "pressure", "poured"})->ArgsProduct({{1024}, {0, 1}, {0, 1}})->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_TickColored)->ArgNames({"size", "fused"})->ArgsProduct({{256, 1024, 2048}, {0, 1}})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_DrawPoint)->Apply(worlds)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_BlitIndexed)->Apply(worlds)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ViewDraw)->ArgNames({"size", "zoom"})->ArgsProduct({{256, 1024, 2048}, {0, -3}})->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_BrushStroke)->ArgNames({"radius", "batched"})->ArgsProduct({{0, 8, 32}, {0, 1}})->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
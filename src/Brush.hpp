@@ -0,0 +1,119 @@
+/**
+ * @file Brush.hpp
+ * @brief Brush of a radius, shape and material, strokes rasterized into row spans
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#ifndef BRUSH_HPP
+#define BRUSH_HPP
+
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+
+#include "Simulation.hpp"
+
+/*
+A Brush paints a material with a square or circular tip of a radius, 0
+being a single cell. The mouse is only sampled once per frame, so a stroke
+is the tip dragged along the Bresenham line from the previous sample to
+the current one, which leaves no gaps however fast the mouse moves.
+
+rasterizeStroke() turns a stroke into the cells it covers, clipped to the
+world. Both tips are convex and so is a convex tip dragged along a line,
+so the stroke covers one run of cells per row: the rasterizer only keeps
+the leftmost and rightmost cell of every row while it stamps the tip,
+and hands back one BrushSpan per row, every cell exactly once, for
+Simulation::fillRow() to write a row at a time.
+*/
+enum class BrushShape : uint8_t {
+    SQUARE,
+    CIRCLE
+};
+
+struct Brush {
+    static constexpr int32_t maxRadius = 64;
+
+    Simulation::CellID material = Simulation::SAND;
+    // water mass of the painted cells
+    float mass = 0.0;
+    int32_t radius = 0;
+    BrushShape shape = BrushShape::CIRCLE;
+};
+
+// length cells from (x, y) to the right
+struct BrushSpan {
+    int32_t x;
+    int32_t y;
+    int32_t length;
+};
+
+// append the cells of brush dragged from (x0, y0) to (x1, y1) to spans, one span per row inside width x height
+inline void rasterizeStroke(const Brush& brush, int32_t x0, int32_t y0, int32_t x1, int32_t y1, int32_t width, int32_t height,
+    std::vector<BrushSpan>& spans) {
+    int32_t r = std::min(std::max(brush.radius, 0), Brush::maxRadius);
+    int32_t top = std::max(std::min(y0, y1) - r, 0);
+    int32_t bottom = std::min(std::max(y0, y1) + r, height - 1);
+    if (top > bottom || width <= 0) {
+        return;
+    }
+
+    // half width of the tip in row dy, r * r + r rounds the circle like a disc of radius r + 0.5
+    int32_t half[2 * Brush::maxRadius + 1];
+    for (int32_t dy = -r; dy <= r; dy ++) {
+        int32_t dx = r;
+        if (brush.shape == BrushShape::CIRCLE) {
+            while (dx * dx + dy * dy > r * r + r) {
+                dx --;
+            }
+        }
+        half[dy + r] = dx;
+    }
+
+    // leftmost and rightmost covered cell of every row, left > right while a row is empty
+    std::vector<int32_t> left(bottom - top + 1, INT32_MAX);
+    std::vector<int32_t> right(bottom - top + 1, INT32_MIN);
+    auto stamp = [&](int32_t x, int32_t y) {
+        for (int32_t dy = std::max(-r, top - y); dy <= std::min(r, bottom - y); dy ++) {
+            int32_t row = y + dy - top;
+            left[row] = std::min(left[row], x - half[dy + r]);
+            right[row] = std::max(right[row], x + half[dy + r]);
+        }
+    };
+
+    // Bresenham, as Canvas::line()
+    int32_t dx = std::abs(x1 - x0);
+    int32_t dy = -std::abs(y1 - y0);
+    int32_t sx = x0 < x1 ? 1 : -1;
+    int32_t sy = y0 < y1 ? 1 : -1;
+    int32_t error = dx + dy;
+    while (true) {
+        stamp(x0, y0);
+        if (x0 == x1 && y0 == y1) break;
+        int32_t e2 = 2 * error;
+        if (e2 >= dy) {
+            error += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx) {
+            error += dx;
+            y0 += sy;
+        }
+    }
+
+    for (int32_t row = 0; row <= bottom - top; row ++) {
+        int32_t x = std::max(left[row], 0);
+        int32_t end = std::min(right[row], width - 1);
+        if (x <= end) {
+            spans.push_back({x, top + row, end - x + 1});
+        }
+    }
+}
+
+#endif
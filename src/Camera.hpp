@@ -0,0 +1,281 @@
+/**
+ * @file Camera.hpp
+ * @brief Pan and zoom camera over the world with a level of detail pyramid for zooming out
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#ifndef CAMERA_HPP
+#define CAMERA_HPP
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#include "Simulation.hpp"
+
+/*
+A Camera maps a viewport of viewWidth x viewHeight pixels onto the world.
+It looks at the world cell (x, y) in the middle of the viewport, zoom is a
+power of two: at zoom z > 0 a cell covers 2^z x 2^z pixels, at z < 0 a
+pixel covers 2^-z x 2^-z cells.
+
+WorldView draws what a camera sees into a viewport sized buffer. Zoomed
+out, a pixel must not cost the 4^-z cells under it, so WorldView keeps a
+pyramid of the world image: level 0 is the world image itself, every
+level above it is half the size of the one below, every pixel the
+majority of the 2 x 2 pixels under it. Drawing samples one pixel of the
+level that matches the zoom per viewport pixel, O(viewport) at any zoom.
+The pyramid is only rebuilt over the regions the simulation reports as
+changed, so keeping it costs O(changed cells).
+
+At a tie the larger pixel value wins, which keeps material visible over
+air, air is the only transparent color and the smallest cell ID.
+
+The pixels are packed RGBA colors for WorldView, BasicWorldView works on
+any pixel type, e.g. one byte cell IDs or masses for shading on the GPU.
+*/
+class Camera {
+private:
+    int32_t viewW;
+    int32_t viewH;
+    double centerX;
+    double centerY;
+    int32_t zoomLevel;
+
+public:
+    static constexpr int32_t minZoom = -6;
+    static constexpr int32_t maxZoom = 4;
+
+    Camera(int32_t viewWidth = 0, int32_t viewHeight = 0)
+        : viewW(viewWidth), viewH(viewHeight), centerX(viewWidth * 0.5), centerY(viewHeight * 0.5), zoomLevel(0) {}
+
+    int32_t viewWidth() const {
+        return viewW;
+    }
+
+    int32_t viewHeight() const {
+        return viewH;
+    }
+
+    int32_t zoom() const {
+        return zoomLevel;
+    }
+
+    // world cells per viewport pixel
+    double cellsPerPixel() const {
+        return std::ldexp(1.0, -zoomLevel);
+    }
+
+    double x() const {
+        return centerX;
+    }
+
+    double y() const {
+        return centerY;
+    }
+
+    void lookAt(double x, double y) {
+        centerX = x;
+        centerY = y;
+    }
+
+    // move by a distance in viewport pixels
+    void pan(double dx, double dy) {
+        centerX += dx * cellsPerPixel();
+        centerY += dy * cellsPerPixel();
+    }
+
+    // zoom by steps powers of two, the world cell under the viewport pixel (px, py) stays put
+    void zoomBy(int32_t steps, double px, double py) {
+        double wx = worldX(px);
+        double wy = worldY(py);
+        zoomLevel = std::min(std::max(zoomLevel + steps, minZoom), maxZoom);
+        centerX = wx - (px - viewW * 0.5) * cellsPerPixel();
+        centerY = wy - (py - viewH * 0.5) * cellsPerPixel();
+    }
+
+    // world position under a viewport position, floor() it for the cell
+    double worldX(double px) const {
+        return centerX + (px - viewW * 0.5) * cellsPerPixel();
+    }
+
+    double worldY(double py) const {
+        return centerY + (py - viewH * 0.5) * cellsPerPixel();
+    }
+
+    // the viewport pixels a rect of world cells covers, clipped to the viewport, empty if none
+    Simulation::Rect viewRect(const Simulation::Rect& world) const {
+        double scale = std::ldexp(1.0, zoomLevel);
+        int32_t x0 = std::max(static_cast<int32_t>(std::floor((world.x - centerX) * scale + viewW * 0.5)) - 1, 0);
+        int32_t y0 = std::max(static_cast<int32_t>(std::floor((world.y - centerY) * scale + viewH * 0.5)) - 1, 0);
+        int32_t x1 = std::min(static_cast<int32_t>(std::ceil((world.x + world.w - centerX) * scale + viewW * 0.5)) + 1, viewW);
+        int32_t y1 = std::min(static_cast<int32_t>(std::ceil((world.y + world.h - centerY) * scale + viewH * 0.5)) + 1, viewH);
+        if (x0 >= x1 || y0 >= y1) {
+            return Simulation::Rect();
+        }
+        return Simulation::Rect(x0, y0, x1 - x0, y1 - y0);
+    }
+
+    bool operator==(const Camera& other) const {
+        return viewW == other.viewW && viewH == other.viewH && centerX == other.centerX && centerY == other.centerY &&
+            zoomLevel == other.zoomLevel;
+    }
+
+    bool operator!=(const Camera& other) const {
+        return !(*this == other);
+    }
+};
+
+template <typename Pixel>
+class BasicWorldView {
+private:
+    struct Level {
+        int32_t w;
+        int32_t h;
+        std::vector<Pixel> pixels;
+    };
+
+    const Pixel* base;
+    int32_t baseW;
+    int32_t baseH;
+    // levels[0] is half of base
+    std::vector<Level> levels;
+    // level coordinate of every viewport column and row, -1 outside the world
+    std::vector<int32_t> columns;
+    std::vector<int32_t> rows;
+
+    // the majority of four pixels, the largest at a tie
+    static Pixel reduce(Pixel a, Pixel b, Pixel c, Pixel d) {
+        if (a == b) {
+            return c == d && c > a ? c : a;
+        }
+        if (a == c) {
+            return b == d && b > a ? b : a;
+        }
+        if (a == d) {
+            return b == c && b > a ? b : a;
+        }
+        if (b == c || b == d) {
+            return b;
+        }
+        if (c == d) {
+            return c;
+        }
+        return std::max(std::max(a, b), std::max(c, d));
+    }
+
+    // rebuild x0 <= x < x1, y0 <= y < y1 of level from the one below
+    void reduceRect(int32_t level, int32_t x0, int32_t y0, int32_t x1, int32_t y1) {
+        const Pixel* below = level == 0 ? base : levels[level - 1].pixels.data();
+        int32_t belowW = level == 0 ? baseW : levels[level - 1].w;
+        int32_t belowH = level == 0 ? baseH : levels[level - 1].h;
+        Level& into = levels[level];
+        for (int32_t y = y0; y < y1; y ++) {
+            // an odd last row or column pairs with itself
+            const Pixel* top = below + static_cast<size_t>(2 * y) * belowW;
+            const Pixel* bottom = below + static_cast<size_t>(std::min(2 * y + 1, belowH - 1)) * belowW;
+            Pixel* out = &into.pixels[static_cast<size_t>(y) * into.w];
+            for (int32_t x = x0; x < x1; x ++) {
+                int32_t left = 2 * x;
+                int32_t right = std::min(left + 1, belowW - 1);
+                out[x] = reduce(top[left], top[right], bottom[left], bottom[right]);
+            }
+        }
+    }
+
+public:
+    BasicWorldView() : base(nullptr), baseW(0), baseH(0) {}
+
+    // the world image, width x height pixels; a new size rebuilds the pyramid
+    void setWorld(const Pixel* pixels, int32_t width, int32_t height) {
+        base = pixels;
+        if (width == baseW && height == baseH) {
+            return;
+        }
+        baseW = width;
+        baseH = height;
+        levels.clear();
+        int32_t w = width;
+        int32_t h = height;
+        while ((w > 1 || h > 1) && static_cast<int32_t>(levels.size()) < -Camera::minZoom) {
+            w = (w + 1) / 2;
+            h = (h + 1) / 2;
+            Level level;
+            level.w = w;
+            level.h = h;
+            level.pixels.assign(static_cast<size_t>(w) * h, 0);
+            levels.push_back(level);
+        }
+        update(Simulation::Rect(0, 0, width, height));
+    }
+
+    bool hasWorld() const {
+        return base != nullptr;
+    }
+
+    // the world image changed in rect, bring the pyramid over it up to date
+    void update(const Simulation::Rect& rect) {
+        int32_t x0 = std::max(rect.x, 0);
+        int32_t y0 = std::max(rect.y, 0);
+        int32_t x1 = std::min(rect.x + rect.w, baseW);
+        int32_t y1 = std::min(rect.y + rect.h, baseH);
+        for (size_t level = 0; level < levels.size() && x0 < x1 && y0 < y1; level ++) {
+            x0 >>= 1;
+            y0 >>= 1;
+            x1 = std::min((x1 + 1) >> 1, levels[level].w);
+            y1 = std::min((y1 + 1) >> 1, levels[level].h);
+            reduceRect(static_cast<int32_t>(level), x0, y0, x1, y1);
+        }
+    }
+
+    // draw what camera sees into pixels, row r at pixels + r * stride, background outside the world
+    void draw(const Camera& camera, Pixel* pixels, ptrdiff_t stride, Pixel background) {
+        draw(camera, pixels, stride, background, Simulation::Rect(0, 0, camera.viewWidth(), camera.viewHeight()));
+    }
+
+    // only the viewport pixels in clip
+    void draw(const Camera& camera, Pixel* pixels, ptrdiff_t stride, Pixel background, const Simulation::Rect& clip) {
+        int32_t level = std::min(std::max(-camera.zoom(), 0), static_cast<int32_t>(levels.size()));
+        const Pixel* source = level == 0 ? base : levels[level - 1].pixels.data();
+        int32_t w = level == 0 ? baseW : levels[level - 1].w;
+        int32_t h = level == 0 ? baseH : levels[level - 1].h;
+        if (!source) {
+            return;
+        }
+        double scale = std::ldexp(1.0, -level);
+
+        columns.resize(camera.viewWidth());
+        rows.resize(camera.viewHeight());
+        for (int32_t px = clip.x; px < clip.x + clip.w; px ++) {
+            int32_t x = static_cast<int32_t>(std::floor(camera.worldX(px + 0.5) * scale));
+            columns[px] = x >= 0 && x < w ? x : -1;
+        }
+        for (int32_t py = clip.y; py < clip.y + clip.h; py ++) {
+            int32_t y = static_cast<int32_t>(std::floor(camera.worldY(py + 0.5) * scale));
+            rows[py] = y >= 0 && y < h ? y : -1;
+        }
+
+        for (int32_t py = clip.y; py < clip.y + clip.h; py ++) {
+            Pixel* out = pixels + py * stride;
+            if (rows[py] < 0) {
+                std::fill(out + clip.x, out + clip.x + clip.w, background);
+                continue;
+            }
+            const Pixel* row = source + static_cast<size_t>(rows[py]) * w;
+            for (int32_t px = clip.x; px < clip.x + clip.w; px ++) {
+                int32_t x = columns[px];
+                out[px] = x >= 0 ? row[x] : background;
+            }
+        }
+    }
+};
+
+typedef BasicWorldView<uint32_t> WorldView;
+
+#endif
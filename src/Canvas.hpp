@@ -0,0 +1,276 @@
+/**
+ * @file Canvas.hpp
+ * @brief Bulk drawing into a packed RGBA pixel buffer
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#ifndef CANVAS_HPP
+#define CANVAS_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CANVAS_X86 1
+#include <immintrin.h>
+#else
+#define CANVAS_X86 0
+#endif
+
+/*
+Canvas draws into a width x height buffer of RGBA pixels, four bytes per
+pixel with the rows packed, the layout R2DEngine uploads to its texture.
+It does not own the buffer.
+
+A pixel is a uint32_t holding the four bytes in memory order, build one
+with Canvas::rgba(). All calls clip to the canvas.
+
+span          horizontal run of one color
+fillRect      rectangle of one color
+line          one pixel wide line from (x0, y0) to (x1, y1)
+blitRow       copy a row of pixels
+blitIndexed   map indices through a palette, e.g. cell ids to colors,
+              indices outside the palette draw 0 (transparent black).
+              An index mask picks the index out of wider words, e.g.
+              0xff for the type byte of packed cells
+text          a line of text in a built-in 3x5 font, for debug overlays.
+              Letters are drawn upper case, characters without a glyph
+              are left blank
+
+The indexed blit is the hot path when the whole world is redrawn, palettes
+of up to paletteLanes colors use SSE2 or AVX2 when the CPU has them.
+*/
+class Canvas {
+public:
+    // palettes up to this size take the vectorized indexed blit
+    static constexpr int32_t paletteLanes = 8;
+    // advance of text() per character and per line
+    static constexpr int32_t glyphWidth = 4;
+    static constexpr int32_t glyphHeight = 6;
+
+private:
+    uint32_t* pixels;
+    int32_t w;
+    int32_t h;
+
+    // clip [x, x + length) of row y, returns false when nothing is left
+    bool clipSpan(int32_t& x, int32_t y, int32_t& length, int32_t& skip) const {
+        skip = 0;
+        if (y < 0 || y >= h || length <= 0) return false;
+        if (x < 0) {
+            skip = -x;
+            length += x;
+            x = 0;
+        }
+        length = std::min(length, w - x);
+        return length > 0;
+    }
+
+    static void blitIndexedScalar(uint32_t* dst, const int32_t* indices, int32_t count, const uint32_t* palette, int32_t paletteSize, uint32_t mask) {
+        for (int32_t i = 0; i < count; i ++) {
+            uint32_t index = static_cast<uint32_t>(indices[i]) & mask;
+            dst[i] = index < static_cast<uint32_t>(paletteSize) ? palette[index] : 0;
+        }
+    }
+
+#if CANVAS_X86
+    // select the palette entry with one compare per color, SSE2 has no variable shuffle
+    static void blitIndexedSSE2(uint32_t* dst, const int32_t* indices, int32_t count, const uint32_t* palette, int32_t paletteSize, uint32_t mask) {
+        __m128i colors[paletteLanes];
+        for (int32_t k = 0; k < paletteSize; k ++) {
+            colors[k] = _mm_set1_epi32(static_cast<int32_t>(palette[k]));
+        }
+        __m128i indexMask = _mm_set1_epi32(static_cast<int32_t>(mask));
+        int32_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128i index = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(indices + i)), indexMask);
+            __m128i result = _mm_setzero_si128();
+            for (int32_t k = 0; k < paletteSize; k ++) {
+                __m128i match = _mm_cmpeq_epi32(index, _mm_set1_epi32(k));
+                result = _mm_or_si128(result, _mm_and_si128(match, colors[k]));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), result);
+        }
+        blitIndexedScalar(dst + i, indices + i, count - i, palette, paletteSize, mask);
+    }
+
+    __attribute__((target("avx2")))
+    static void blitIndexedAVX2(uint32_t* dst, const int32_t* indices, int32_t count, const uint32_t* palette, int32_t paletteSize, uint32_t mask) {
+        alignas(32) uint32_t table[paletteLanes] = {};
+        memcpy(table, palette, paletteSize * sizeof(uint32_t));
+        __m256i colors = _mm256_load_si256(reinterpret_cast<const __m256i*>(table));
+        __m256i size = _mm256_set1_epi32(paletteSize);
+        __m256i negative = _mm256_set1_epi32(-1);
+        __m256i indexMask = _mm256_set1_epi32(static_cast<int32_t>(mask));
+        int32_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i index = _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices + i)), indexMask);
+            __m256i valid = _mm256_and_si256(_mm256_cmpgt_epi32(size, index), _mm256_cmpgt_epi32(index, negative));
+            __m256i result = _mm256_and_si256(_mm256_permutevar8x32_epi32(colors, index), valid);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), result);
+        }
+        blitIndexedScalar(dst + i, indices + i, count - i, palette, paletteSize, mask);
+    }
+#endif
+
+public:
+    // count pixels of dst from indices, unclipped, for callers that color cells as they produce them
+    static void blitIndexedRow(uint32_t* dst, const int32_t* indices, int32_t count, const uint32_t* palette, int32_t paletteSize, uint32_t mask) {
+#if CANVAS_X86
+        static const bool avx2 = __builtin_cpu_supports("avx2");
+        static const bool sse2 = __builtin_cpu_supports("sse2");
+        if (paletteSize <= paletteLanes) {
+            if (avx2) {
+                blitIndexedAVX2(dst, indices, count, palette, paletteSize, mask);
+                return;
+            } else if (sse2) {
+                blitIndexedSSE2(dst, indices, count, palette, paletteSize, mask);
+                return;
+            }
+        }
+#endif
+        blitIndexedScalar(dst, indices, count, palette, paletteSize, mask);
+    }
+
+private:
+    // 3x5 bitmap of an ASCII character, 15 bits row by row from the top left
+    static uint16_t glyph(char c) {
+        static const uint16_t glyphs[64] = {
+            0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x52a5, 0x0000, 0x0000,
+            0x2922, 0x224a, 0x0000, 0x05d0, 0x0014, 0x01c0, 0x0002, 0x12a4,
+            0x7b6f, 0x2c97, 0x73e7, 0x73cf, 0x5bc9, 0x79cf, 0x79ef, 0x7249,
+            0x7bef, 0x7bcf, 0x0410, 0x0000, 0x0000, 0x0e38, 0x0000, 0x0000,
+            0x0000, 0x2bed, 0x6bae, 0x3923, 0x6b6e, 0x79a7, 0x79a4, 0x396b,
+            0x5bed, 0x7497, 0x126a, 0x5bad, 0x4927, 0x5fed, 0x6b6d, 0x2b6a,
+            0x6ba4, 0x2b73, 0x6bad, 0x388e, 0x7492, 0x5b6f, 0x5b6a, 0x5bfd,
+            0x5aad, 0x5a92, 0x72a7, 0x0000, 0x0000, 0x0000, 0x0000, 0x0007,
+        };
+        if (c >= 'a' && c <= 'z') {
+            c = static_cast<char>(c - 'a' + 'A');
+        }
+        return c >= 32 && c < 96 ? glyphs[c - 32] : 0;
+    }
+
+public:
+    Canvas() : pixels(nullptr), w(0), h(0) {}
+
+    Canvas(uint8_t* data, int32_t width, int32_t height) : pixels(reinterpret_cast<uint32_t*>(data)), w(width), h(height) {}
+
+    static uint32_t rgba(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
+        uint8_t bytes[4] = {r, g, b, a};
+        uint32_t pixel;
+        memcpy(&pixel, bytes, sizeof(pixel));
+        return pixel;
+    }
+
+    int32_t width() const {
+        return w;
+    }
+
+    int32_t height() const {
+        return h;
+    }
+
+    uint32_t* operator[](int32_t y) {
+        return pixels + static_cast<ptrdiff_t>(y) * w;
+    }
+
+    const uint32_t* operator[](int32_t y) const {
+        return pixels + static_cast<ptrdiff_t>(y) * w;
+    }
+
+    void point(int32_t x, int32_t y, uint32_t pixel) {
+        if (0 <= x && x < w && 0 <= y && y < h) {
+            (*this)[y][x] = pixel;
+        }
+    }
+
+    void span(int32_t x, int32_t y, int32_t length, uint32_t pixel) {
+        int32_t skip;
+        if (!clipSpan(x, y, length, skip)) return;
+        std::fill_n((*this)[y] + x, length, pixel);
+    }
+
+    void fillRect(int32_t x, int32_t y, int32_t width, int32_t height, uint32_t pixel) {
+        int32_t y0 = std::max(y, 0);
+        int32_t y1 = std::min(y + height, h);
+        for (int32_t row = y0; row < y1; row ++) {
+            span(x, row, width, pixel);
+        }
+    }
+
+    void line(int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint32_t pixel) {
+        if (y0 == y1) {
+            span(std::min(x0, x1), y0, std::abs(x1 - x0) + 1, pixel);
+            return;
+        }
+        // Bresenham
+        int32_t dx = std::abs(x1 - x0);
+        int32_t dy = -std::abs(y1 - y0);
+        int32_t sx = x0 < x1 ? 1 : -1;
+        int32_t sy = y0 < y1 ? 1 : -1;
+        int32_t error = dx + dy;
+        while (true) {
+            point(x0, y0, pixel);
+            if (x0 == x1 && y0 == y1) break;
+            int32_t e2 = 2 * error;
+            if (e2 >= dy) {
+                error += dy;
+                x0 += sx;
+            }
+            if (e2 <= dx) {
+                error += dx;
+                y0 += sy;
+            }
+        }
+    }
+
+    void blitRow(int32_t x, int32_t y, const uint32_t* source, int32_t count) {
+        int32_t skip;
+        if (!clipSpan(x, y, count, skip)) return;
+        memcpy((*this)[y] + x, source + skip, count * sizeof(uint32_t));
+    }
+
+    void blitIndexed(int32_t x, int32_t y, const int32_t* indices, int32_t count, const uint32_t* palette, int32_t paletteSize,
+        uint32_t mask = ~0u) {
+        int32_t skip;
+        if (!clipSpan(x, y, count, skip)) return;
+        blitIndexedRow((*this)[y] + x, indices + skip, count, palette, paletteSize, mask);
+    }
+
+    // top left corner at (x, y), returns the x after the last character
+    int32_t text(int32_t x, int32_t y, const char* string, uint32_t pixel) {
+        for (; *string; string ++) {
+            uint16_t bits = glyph(*string);
+            for (int32_t row = 0; row < 5; row ++) {
+                for (int32_t column = 0; column < 3; column ++) {
+                    if (bits & (0x4000 >> (row * 3 + column))) {
+                        point(x + column, y + row, pixel);
+                    }
+                }
+            }
+            x += glyphWidth;
+        }
+        return x;
+    }
+
+    // width x height indices, row r starts at indices + r * stride
+    void blitIndexed(int32_t x, int32_t y, int32_t width, int32_t height, const int32_t* indices, ptrdiff_t stride,
+        const uint32_t* palette, int32_t paletteSize, uint32_t mask = ~0u) {
+        int32_t y0 = std::max(y, 0);
+        int32_t y1 = std::min(y + height, h);
+        for (int32_t row = y0; row < y1; row ++) {
+            blitIndexed(x, row, indices + (row - y) * stride, width, palette, paletteSize, mask);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,98 @@
+/**
+ * @file Cell.hpp
+ * @brief Packed 32-bit cell: material type, flags and fixed-point mass
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#ifndef CELL_HPP
+#define CELL_HPP
+
+#include <cstdint>
+
+/*
+Cell packs everything the simulation keeps per cell into one 32-bit word,
+so a world of w x h cells costs 4 bytes per cell and grid instead of an
+id grid and a float mass grid side by side. On little-endian machines the
+word reads as
+
+bits 0..7    type, a Simulation::CellID
+bits 8..15   flags
+bits 16..31  mass in units of 1 / massScale
+
+and the vector kernels rely on that layout: a 16-bit saturating add of a
+flow shifted left by 16 updates the mass and leaves type and flags alone.
+
+Mass is fixed point with massShift fraction bits. One unit is about half
+of Water::minMass, and the largest mass, just under 32, is what a column
+of roughly 1500 cells of water compresses its bottom cell to. Sums clamp
+to that instead of wrapping.
+*/
+struct Cell {
+    enum Flags : uint8_t {
+        // in-place update: parity of the last tick that moved the cell
+        UPDATED = 1,
+        // the last tick that committed the cell left its type and mass unchanged
+        SLEEPING = 2
+    };
+
+    static constexpr int32_t massShift = 11;
+    static constexpr float massScale = static_cast<float>(1 << massShift);
+    static constexpr float massUnit = 1.0f / massScale;
+    static constexpr int32_t maxUnits = 0xffff;
+
+    uint8_t type;
+    uint8_t flags;
+    uint16_t mass;
+
+    Cell(uint8_t type = 0, uint16_t mass = 0, uint8_t flags = 0) : type(type), flags(flags), mass(mass) {}
+
+    // nearest representable mass, clamped to [0, maxUnits]
+    static uint16_t toUnits(float value) {
+        float units = value * massScale + 0.5f;
+        if (!(units > 0.0f)) {
+            return 0;
+        }
+        return units >= maxUnits ? maxUnits : static_cast<uint16_t>(units);
+    }
+
+    static float toMass(int32_t units) {
+        return static_cast<float>(units) * massUnit;
+    }
+
+    // a flow in units, rounded toward zero so a cell never sends more than it has
+    static int32_t flowUnits(float flow) {
+        return static_cast<int32_t>(flow * massScale);
+    }
+
+    // saturating, the same as the 16-bit saturating adds of the vector kernels
+    static uint16_t addUnits(uint16_t units, int32_t flow) {
+        int32_t sum = units + flow;
+        return sum > maxUnits ? maxUnits : static_cast<uint16_t>(sum);
+    }
+
+    static uint16_t subUnits(uint16_t units, int32_t flow) {
+        int32_t difference = units - flow;
+        return difference < 0 ? 0 : static_cast<uint16_t>(difference);
+    }
+
+    float massValue() const {
+        return toMass(mass);
+    }
+
+    bool operator==(const Cell& other) const {
+        return type == other.type && flags == other.flags && mass == other.mass;
+    }
+
+    bool operator!=(const Cell& other) const {
+        return !(*this == other);
+    }
+};
+
+static_assert(sizeof(Cell) == 4, "Cell must pack into one 32-bit word");
+
+#endif
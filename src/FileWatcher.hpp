@@ -0,0 +1,123 @@
+/**
+ * @file FileWatcher.hpp
+ * @brief Non-blocking notification of files written on disk, through inotify
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#ifndef FILEWATCHER_HPP
+#define FILEWATCHER_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#define FILE_WATCHER_INOTIFY 1
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#else
+#define FILE_WATCHER_INOTIFY 0
+#endif
+
+/*
+A FileWatcher tells a loop that polls it once per frame whether any of its
+files was written since the last poll, without a thread and without
+stat()ing the files every frame.
+
+It watches the directories of the files rather than the files: editors
+save by writing a new file and renaming it over the old one, which ends
+a watch on the old inode. A finished write (IN_CLOSE_WRITE) or a file
+renamed into place (IN_MOVED_TO) under a watched name counts as a change,
+a file that is only created is still being written.
+
+Only Linux has inotify, elsewhere watch() fails and nothing ever changes.
+*/
+class FileWatcher {
+private:
+    struct Watched {
+        int32_t directory;
+        std::string name;
+    };
+
+    int32_t fd;
+    std::vector<Watched> files;
+
+public:
+    FileWatcher() : fd(-1) {}
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    ~FileWatcher() {
+#if FILE_WATCHER_INOTIFY
+        if (fd >= 0) {
+            close(fd);
+        }
+#endif
+    }
+
+    // report writes to the file at path, false if it can not be watched
+    bool watch(const std::string& path) {
+#if FILE_WATCHER_INOTIFY
+        if (fd < 0) {
+            fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            if (fd < 0) {
+                return false;
+            }
+        }
+        size_t slash = path.find_last_of('/');
+        std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+        std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+        // a directory watched twice keeps its descriptor
+        int32_t wd = inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (wd < 0) {
+            return false;
+        }
+        files.push_back({wd, name});
+        return true;
+#else
+        (void)path;
+        return false;
+#endif
+    }
+
+    // true if a watched file was written since the last call, never blocks
+    bool changed() {
+        bool any = false;
+#if FILE_WATCHER_INOTIFY
+        if (fd < 0) {
+            return false;
+        }
+        alignas(inotify_event) char buffer[4096];
+        while (true) {
+            ssize_t length = read(fd, buffer, sizeof(buffer));
+            if (length <= 0) {
+                // EAGAIN, every event is read
+                break;
+            }
+            for (ssize_t offset = 0; offset < length; ) {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+                offset += sizeof(inotify_event) + event->len;
+                if (event->len == 0) {
+                    continue;
+                }
+                for (const Watched& file : files) {
+                    if (file.directory == event->wd && file.name == event->name) {
+                        any = true;
+                    }
+                }
+            }
+        }
+#endif
+        return any;
+    }
+};
+
+#endif
@@ -0,0 +1,629 @@
+/**
+ * @file GpuSimulation.hpp
+ * @brief Powder and water rules as OpenGL compute passes on GPU textures
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#ifndef GPUSIMULATION_HPP
+#define GPUSIMULATION_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifndef __glew_h__
+#define GL_GLEXT_PROTOTYPES 1
+#include <GL/glcorearb.h>
+#endif
+
+#include "Simulation.hpp"
+
+/*
+GpuSimulation keeps the world in textures and runs Simulation's rules with
+compute shaders, it needs a current OpenGL 4.3 context. Cells only come
+back to the CPU through read() and stateHash().
+
+The textures hold the fields of the CPU's packed cells, including the
+one-cell halo of walls: map and mapBuffer the types, mass and massBuffer
+the fixed-point masses in units of Cell::massUnit, plus swept, which holds
+every row as the serial sweep leaves it after the powders of that row moved.
+Types and masses stay in separate textures because a row dispatch writes
+the type and the mass of one texel from different invocations. Cell flags
+are not kept. A tick is
+
+rows    one dispatch per row, bottom to top, one invocation per cell. It
+        moves the powders and static cells of the row into mapBuffer,
+        writes the swept row, then applies the water flows in and out of
+        the cell in whole units and in the order update_water does (see
+        WaterKernel.hpp). Flows of the two neighbors are recomputed by
+        each invocation instead of being exchanged, so a row needs no
+        barrier inside the dispatch.
+commit  one dispatch over the world, turns mass into water, copies
+        mapBuffer and massBuffer back and resets mapBuffer to air.
+
+The shaders get the material table as GLSL constant arrays generated from
+Materials::lookup, so a new material needs no shader change. Where the
+serial sweep lets two powders of a row fall into the same cell, the later
+one overwrites the earlier; an invocation skips its write when one of the
+two powders to its right targets the same cell, which keeps that order.
+
+Each row reads what the previous one wrote, like the CPU sweep, which is
+what makes the result match Simulation::tick() with chunk sleeping
+disabled. Every float expression is precise, so the driver can not
+contract it into FMAs.
+*/
+static_assert(Cell::massShift == 11 && Cell::maxUnits == 0xffff, "the shaders of GpuSimulation hard-code the mass format");
+
+class GpuSimulation {
+public:
+    typedef Simulation::CellID CellID;
+
+    // palettes of draw() hold up to this many colors
+    static constexpr int32_t maxPalette = 8;
+    static_assert(Materials::COUNT <= maxPalette, "the draw palette holds a color per material");
+
+private:
+    enum Texture {
+        MAP,
+        MAP_BUFFER,
+        SWEPT,
+        MASS,
+        MASS_BUFFER,
+        TEXTURE_COUNT
+    };
+
+    static constexpr int32_t rowGroup = 64;
+    static constexpr int32_t tileGroup = 8;
+
+    int32_t w;
+    int32_t h;
+    uint64_t ticks;
+    GLuint textures[TEXTURE_COUNT];
+    GLuint rowProgram;
+    GLuint commitProgram;
+    GLuint drawProgram;
+    GLint rowLocation;
+    std::string message;
+
+    // the cell types and the material table as GLSL constants, see Materials.hpp
+    static std::string materialSource() {
+        std::string rules;
+        std::string yields;
+        std::string densities;
+        std::string fluids;
+        for (int32_t i = 0; i < Materials::COUNT; i ++) {
+            const char* separator = i ? ", " : "";
+            rules += separator + std::to_string(static_cast<int32_t>(Materials::lookup.rule[i]));
+            yields += separator + std::to_string(Materials::lookup.yield[i]);
+            densities += separator + std::to_string(Materials::lookup.density[i]);
+            fluids += separator + std::string(Materials::lookup.fluid[i] ? "true" : "false");
+        }
+        std::string count = std::to_string(Materials::COUNT);
+        return "const int AIR = " + std::to_string(Materials::AIR) + ";\n"
+            "const int WALL = " + std::to_string(Materials::WALL) + ";\n"
+            "const int WATER = " + std::to_string(Materials::WATER) + ";\n"
+            "const int RULE_NONE = " + std::to_string(static_cast<int32_t>(Materials::Rule::NONE)) + ";\n"
+            "const int RULE_STATIC = " + std::to_string(static_cast<int32_t>(Materials::Rule::STATIC)) + ";\n"
+            "const int RULE_POWDER = " + std::to_string(static_cast<int32_t>(Materials::Rule::POWDER)) + ";\n"
+            "const int MATERIALS = " + count + ";\n"
+            "const int materialRules[" + count + "] = int[](" + rules + ");\n"
+            "const int materialYields[" + count + "] = int[](" + yields + ");\n"
+            "const int materialDensities[" + count + "] = int[](" + densities + ");\n"
+            "const bool materialFluids[" + count + "] = bool[](" + fluids + ");\n";
+    }
+
+    static std::string commonSource() {
+        return "#version 430\n" + materialSource() + R"(
+// Materials::lookup, types without a row never move and are never displaced
+bool known(int id) {
+    return id >= 0 && id < MATERIALS;
+}
+
+int rule(int id) {
+    return known(id) ? materialRules[id] : RULE_NONE;
+}
+
+int yield(int id) {
+    return known(id) ? materialYields[id] : 255;
+}
+
+int density(int id) {
+    return known(id) ? materialDensities[id] : 255;
+}
+
+bool fluid(int id) {
+    return known(id) && materialFluids[id];
+}
+
+layout (r32i, binding = 0) uniform iimage2D map;
+layout (r32i, binding = 1) uniform iimage2D mapBuffer;
+layout (r32i, binding = 2) uniform iimage2D swept;
+layout (r32i, binding = 3) uniform iimage2D mass;
+layout (r32i, binding = 4) uniform iimage2D massBuffer;
+
+// Cell.hpp: masses count units of 1 / 2048 and saturate at 65535
+const float massScale = 2048.0;
+const float massUnit = 1.0 / 2048.0;
+const int maxUnits = 65535;
+
+// texels include the halo, cell (x, y) is texel (x + 1, y + 1)
+uniform ivec2 size;
+)";
+    }
+
+    static const char* rowSource() {
+        return R"(
+layout (local_size_x = 64) in;
+
+const float maxMass = 1.0;
+const float maxCompress = 0.02;
+const float minFlow = 0.01;
+const float maxSpeed = 1.0;
+
+// texel row being swept
+uniform int row;
+
+int cell(int x, int y) {
+    return imageLoad(map, ivec2(x, y)).r;
+}
+
+int below(int x) {
+    return imageLoad(swept, ivec2(x, row + 1)).r;
+}
+
+float cellMass(int x, int y) {
+    return float(imageLoad(mass, ivec2(x, y)).r) * massUnit;
+}
+
+// Cell::flowUnits(), rounded toward zero
+int units(float flow) {
+    return int(flow * massScale);
+}
+
+int addUnits(int m, int flow) {
+    return min(m + flow, maxUnits);
+}
+
+int subUnits(int m, int flow) {
+    return max(m - flow, 0);
+}
+
+// column the powder of (x, row) falls into, -1 when it stays or is no powder, as update_powder
+int powderTarget(int x) {
+    int id = cell(x, row);
+    if (rule(id) != RULE_POWDER) {
+        return -1;
+    }
+    int weight = density(id);
+    if (yield(below(x)) < weight) {
+        return x;
+    } else if (yield(below(x - 1)) < weight) {
+        return x - 1;
+    } else if (yield(below(x + 1)) < weight) {
+        return x + 1;
+    }
+    return -1;
+}
+
+// type of (x, row) once the powders of the row moved, a mover takes the type it displaced
+int sweptCell(int x) {
+    int target = powderTarget(x);
+    return target < 0 ? cell(x, row) : below(target);
+}
+
+float calcFlow(float totalMass) {
+    precise float result;
+    if (totalMass <= 1.0) {
+        result = 1.0;
+    } else if (totalMass < 2.0 * maxMass + maxCompress) {
+        result = (maxMass * maxMass + totalMass * maxCompress) / (maxMass + maxCompress);
+    } else {
+        result = (totalMass + maxCompress) / 2.0;
+    }
+    return result;
+}
+
+float constrain(float x, float minimum, float maximum) {
+    if (x < minimum) {
+        return minimum;
+    } else if (x > maximum) {
+        return maximum;
+    }
+    return x;
+}
+
+float halve(float flow) {
+    return flow > minFlow ? flow * 0.5 : flow;
+}
+
+// mass units (x, row) sends down, right, left and up, as update_water
+ivec4 flows(int x) {
+    ivec4 result = ivec4(0);
+    if (cell(x, row) != WATER) {
+        return result;
+    }
+    float startMass = cellMass(x, row);
+    precise float remainingMass = startMass;
+    precise float flow;
+    if (remainingMass <= 0.0) return result;
+
+    if (fluid(below(x))) {
+        float massBelow = cellMass(x, row + 1);
+        flow = calcFlow(remainingMass + massBelow) - massBelow;
+        result.x = units(constrain(halve(flow), 0.0, min(maxSpeed, remainingMass)));
+        remainingMass -= float(result.x) * massUnit;
+    }
+    if (remainingMass <= 0.0) return result;
+
+    if (fluid(cell(x + 1, row))) {
+        flow = (startMass - cellMass(x + 1, row)) / 4.0;
+        result.y = units(constrain(halve(flow), 0.0, remainingMass));
+        remainingMass -= float(result.y) * massUnit;
+    }
+    if (remainingMass <= 0.0) return result;
+
+    if (fluid(sweptCell(x - 1))) {
+        flow = (startMass - cellMass(x - 1, row)) / 4.0;
+        result.z = units(constrain(halve(flow), 0.0, remainingMass));
+        remainingMass -= float(result.z) * massUnit;
+    }
+    if (remainingMass <= 0.0) return result;
+
+    if (fluid(cell(x, row - 1))) {
+        flow = remainingMass - calcFlow(remainingMass + cellMass(x, row - 1));
+        result.w = units(constrain(halve(flow), 0.0, min(maxSpeed, remainingMass)));
+    }
+    return result;
+}
+
+void main() {
+    int x = int(gl_GlobalInvocationID.x) + 1;
+    if (x >= size.x - 1) {
+        return;
+    }
+
+    // powders and static cells
+    int id = cell(x, row);
+    if (rule(id) == RULE_POWDER) {
+        int target = powderTarget(x);
+        if (target < 0) {
+            imageStore(mapBuffer, ivec2(x, row), ivec4(id));
+        } else {
+            // the serial sweep lets the last of the row's powders falling into a cell win
+            if (powderTarget(x + 1) != target && powderTarget(x + 2) != target) {
+                imageStore(mapBuffer, ivec2(target, row + 1), ivec4(id));
+            }
+            int displaced = below(target);
+            if (!fluid(displaced)) {
+                imageStore(mapBuffer, ivec2(x, row), ivec4(displaced));
+            }
+        }
+    } else if (rule(id) == RULE_STATIC) {
+        imageStore(mapBuffer, ivec2(x, row), ivec4(id));
+    }
+    imageStore(swept, ivec2(x, row), ivec4(sweptCell(x)));
+
+    // water, in the order the serial sweep adds it up
+    ivec4 flow = flows(x);
+    int m = imageLoad(massBuffer, ivec2(x, row)).r;
+    m = addUnits(m, flows(x - 1).y);
+    m = subUnits(m, flow.x);
+    m = subUnits(m, flow.y);
+    m = subUnits(m, flow.z);
+    m = subUnits(m, flow.w);
+    m = addUnits(m, flows(x + 1).z);
+    imageStore(massBuffer, ivec2(x, row), ivec4(m));
+    int down = addUnits(imageLoad(massBuffer, ivec2(x, row + 1)).r, flow.x);
+    imageStore(massBuffer, ivec2(x, row + 1), ivec4(down));
+    int up = addUnits(imageLoad(massBuffer, ivec2(x, row - 1)).r, flow.w);
+    imageStore(massBuffer, ivec2(x, row - 1), ivec4(up));
+}
+)";
+    }
+
+    static const char* commitSource() {
+        return R"(
+layout (local_size_x = 8, local_size_y = 8) in;
+
+const float minMass = 0.001;
+
+void main() {
+    ivec2 p = ivec2(gl_GlobalInvocationID.xy) + 1;
+    if (p.x >= size.x - 1 || p.y >= size.y - 1) {
+        return;
+    }
+    int id = imageLoad(mapBuffer, p).r;
+    int m = imageLoad(massBuffer, p).r;
+    if (fluid(id) && float(m) * massUnit > minMass) {
+        id = WATER;
+    }
+    imageStore(map, p, ivec4(id));
+    imageStore(mass, p, ivec4(m));
+    imageStore(mapBuffer, p, ivec4(AIR));
+}
+)";
+    }
+
+    static const char* drawSource() {
+        return R"(
+layout (local_size_x = 8, local_size_y = 8) in;
+
+layout (rgba8, binding = 5) uniform writeonly image2D target;
+
+// packed RGBA, the byte order of Canvas::rgba()
+uniform uint palette[8];
+uniform int paletteSize;
+
+void main() {
+    ivec2 p = ivec2(gl_GlobalInvocationID.xy);
+    if (p.x >= size.x - 2 || p.y >= size.y - 2) {
+        return;
+    }
+    int id = imageLoad(map, p + 1).r;
+    vec4 color = id >= 0 && id < paletteSize ? unpackUnorm4x8(palette[id]) : vec4(0.0);
+    imageStore(target, p, color);
+}
+)";
+    }
+
+    bool fail(const std::string& what) {
+        message = what;
+        return false;
+    }
+
+    GLuint compile(const char* source) {
+        std::string common = commonSource();
+        const char* sources[2] = {common.c_str(), source};
+        GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+        glShaderSource(shader, 2, sources, nullptr);
+        glCompileShader(shader);
+
+        GLint test;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &test);
+        if (!test) {
+            GLchar log[1024] = {0};
+            glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+            message = std::string("compute shader compilation failed: ") + log;
+            glDeleteShader(shader);
+            return 0;
+        }
+
+        GLuint program = glCreateProgram();
+        glAttachShader(program, shader);
+        glLinkProgram(program);
+        glDeleteShader(shader);
+        glGetProgramiv(program, GL_LINK_STATUS, &test);
+        if (!test) {
+            GLchar log[1024] = {0};
+            glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+            message = std::string("failed to link compute program: ") + log;
+            glDeleteProgram(program);
+            return 0;
+        }
+
+        glUseProgram(program);
+        glUniform2i(glGetUniformLocation(program, "size"), w + 2, h + 2);
+        return program;
+    }
+
+    void bindImages() {
+        glBindImageTexture(0, textures[MAP], 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32I);
+        glBindImageTexture(1, textures[MAP_BUFFER], 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32I);
+        glBindImageTexture(2, textures[SWEPT], 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32I);
+        glBindImageTexture(3, textures[MASS], 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32I);
+        glBindImageTexture(4, textures[MASS_BUFFER], 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32I);
+    }
+
+    // count texels from cell (x, y) to the right
+    void writeTexels(Texture texture, int32_t x, int32_t y, int32_t count, const int32_t* values) {
+        glBindTexture(GL_TEXTURE_2D, textures[texture]);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x + 1, y + 1, count, 1, GL_RED_INTEGER, GL_INT, values);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    void release() {
+        if (textures[0]) {
+            glDeleteTextures(TEXTURE_COUNT, textures);
+        }
+        if (rowProgram) {
+            glDeleteProgram(rowProgram);
+        }
+        if (commitProgram) {
+            glDeleteProgram(commitProgram);
+        }
+        if (drawProgram) {
+            glDeleteProgram(drawProgram);
+        }
+        for (int32_t i = 0; i < TEXTURE_COUNT; i ++) {
+            textures[i] = 0;
+        }
+        rowProgram = 0;
+        commitProgram = 0;
+        drawProgram = 0;
+    }
+
+public:
+    GpuSimulation() : w(0), h(0), ticks(0), rowProgram(0), commitProgram(0), drawProgram(0), rowLocation(-1) {
+        for (int32_t i = 0; i < TEXTURE_COUNT; i ++) {
+            textures[i] = 0;
+        }
+    }
+
+    GpuSimulation(const GpuSimulation&) = delete;
+    GpuSimulation& operator=(const GpuSimulation&) = delete;
+
+    ~GpuSimulation() {
+        release();
+    }
+
+    // compile the passes and allocate an empty world, false if the context can not run them
+    bool create(int32_t width, int32_t height) {
+        release();
+        w = width;
+        h = height;
+        ticks = 0;
+
+        GLint major = 0;
+        GLint minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        if (major < 4 || (major == 4 && minor < 3)) {
+            return fail("compute shaders need OpenGL 4.3, the context has " + std::to_string(major) + "." + std::to_string(minor));
+        }
+
+        rowProgram = compile(rowSource());
+        commitProgram = compile(commitSource());
+        drawProgram = compile(drawSource());
+        glUseProgram(0);
+        if (!rowProgram || !commitProgram || !drawProgram) {
+            release();
+            return false;
+        }
+        rowLocation = glGetUniformLocation(rowProgram, "row");
+
+        glGenTextures(TEXTURE_COUNT, textures);
+        for (int32_t i = 0; i < TEXTURE_COUNT; i ++) {
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32I, w + 2, h + 2);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        upload(Simulation(w, h));
+        return true;
+    }
+
+    // why create() failed
+    const std::string& error() const {
+        return message;
+    }
+
+    int32_t width() const {
+        return w;
+    }
+
+    int32_t height() const {
+        return h;
+    }
+
+    uint64_t tickCount() const {
+        return ticks;
+    }
+
+    // replace the world and the tick count with those of a CPU simulation of the same size
+    void upload(const Simulation& sim) {
+        size_t texels = static_cast<size_t>(w + 2) * (h + 2);
+        std::vector<int32_t> ids(texels, Simulation::WALL);
+        std::vector<int32_t> masses(texels, 0);
+        for (int32_t y = -1; y <= h; y ++) {
+            const Cell* row = sim.cells()[y];
+            for (int32_t x = -1; x <= w; x ++) {
+                ids[(y + 1) * (w + 2) + x + 1] = row[x].type;
+                masses[(y + 1) * (w + 2) + x + 1] = row[x].mass;
+            }
+        }
+        std::vector<int32_t> air(texels, Simulation::AIR);
+        std::vector<int32_t> walls(texels, Simulation::WALL);
+
+        const void* data[TEXTURE_COUNT] = {ids.data(), air.data(), walls.data(), masses.data(), masses.data()};
+        for (int32_t i = 0; i < TEXTURE_COUNT; i ++) {
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w + 2, h + 2, GL_RED_INTEGER, GL_INT, data[i]);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        ticks = sim.tickCount();
+    }
+
+    // coordinates outside the world are ignored
+    void set(int32_t x, int32_t y, CellID id, float cellMass = 0.0) {
+        if (x < 0 || x >= w || y < 0 || y >= h) {
+            return;
+        }
+        fillRow(x, y, 1, id, cellMass);
+    }
+
+    // set() of length cells from (x, y) to the right, clipped to the world, one upload per texture
+    void fillRow(int32_t x, int32_t y, int32_t length, CellID id, float cellMass = 0.0) {
+        if (x < 0) {
+            length += x;
+            x = 0;
+        }
+        length = std::min(length, w - x);
+        if (y < 0 || y >= h || length <= 0) {
+            return;
+        }
+        std::vector<int32_t> ids(length, id);
+        std::vector<int32_t> units(length, Cell::toUnits(cellMass));
+        writeTexels(MAP, x, y, length, ids.data());
+        writeTexels(MASS, x, y, length, units.data());
+        writeTexels(MASS_BUFFER, x, y, length, units.data());
+    }
+
+    void tick() {
+        bindImages();
+        glUseProgram(rowProgram);
+        GLuint groups = (w + rowGroup - 1) / rowGroup;
+        for (int32_t y = h - 1; y >= 0; y --) {
+            glUniform1i(rowLocation, y + 1);
+            glDispatchCompute(groups, 1, 1);
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        }
+        glUseProgram(commitProgram);
+        glDispatchCompute((w + tileGroup - 1) / tileGroup, (h + tileGroup - 1) / tileGroup, 1);
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+        glUseProgram(0);
+        ticks ++;
+    }
+
+    // color the cells into an RGBA8 texture of the world's size, palette as Canvas::rgba()
+    void draw(GLuint texture, const uint32_t* palette, int32_t paletteSize) {
+        paletteSize = std::min(paletteSize, maxPalette);
+        bindImages();
+        glBindImageTexture(5, texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+        glUseProgram(drawProgram);
+        glUniform1uiv(glGetUniformLocation(drawProgram, "palette"), paletteSize, palette);
+        glUniform1i(glGetUniformLocation(drawProgram, "paletteSize"), paletteSize);
+        glDispatchCompute((w + tileGroup - 1) / tileGroup, (h + tileGroup - 1) / tileGroup, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+        glUseProgram(0);
+    }
+
+    // copy the world back, the grid must have the same size, flags read as 0
+    void read(Grid<Cell>& cells) const {
+        size_t texels = static_cast<size_t>(w + 2) * (h + 2);
+        std::vector<int32_t> ids(texels);
+        std::vector<int32_t> masses(texels);
+        glBindTexture(GL_TEXTURE_2D, textures[MAP]);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RED_INTEGER, GL_INT, ids.data());
+        glBindTexture(GL_TEXTURE_2D, textures[MASS]);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RED_INTEGER, GL_INT, masses.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+        for (int32_t y = 0; y < h; y ++) {
+            for (int32_t x = 0; x < w; x ++) {
+                size_t i = static_cast<size_t>(y + 1) * (w + 2) + x + 1;
+                cells[y][x] = Cell(static_cast<uint8_t>(ids[i]), static_cast<uint16_t>(masses[i]));
+            }
+        }
+    }
+
+    // the same hash as Simulation::stateHash() of an identical world
+    uint64_t stateHash() const {
+        Grid<Cell> cells(w, h);
+        read(cells);
+        uint64_t hash = 1469598103934665603ull;
+        for (int32_t y = 0; y < h; y ++) {
+            for (int32_t x = 0; x < w; x ++) {
+                hash = (hash ^ static_cast<uint64_t>(cells[y][x].type)) * 1099511628211ull;
+                hash = (hash ^ static_cast<uint64_t>(cells[y][x].mass)) * 1099511628211ull;
+            }
+        }
+        return hash;
+    }
+};
+
+#endif
@@ -0,0 +1,197 @@
+/**
+ * @file Grid.hpp
+ * @brief Contiguous 2D cell grid with a one-cell halo
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#ifndef GRID_HPP
+#define GRID_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <utility>
+#include <type_traits>
+
+/*
+Grid<T> keeps width x height cells in a single aligned allocation.
+
+Every row is surrounded by a one-cell halo and there is one halo row above
+and below the grid, so for any cell inside the grid all eight neighbors
+(x +- 1, y +- 1) can be read and written without bounds checks.
+
+grid[y]         pointer to the first cell of row y, grid[y][-1] is the halo
+grid(x, y)      reference to a cell
+grid.stride()   distance between two rows in cells
+
+The first cell of every row is aligned to Grid<T>::alignment bytes, which
+keeps row sweeps on whole cache lines.
+*/
+template <typename T>
+class Grid {
+    static_assert(std::is_trivially_copyable<T>::value, "Grid<T> requires a trivially copyable T");
+
+public:
+    static constexpr size_t alignment = 64;
+
+private:
+    // cells reserved in front of every row so that x = 0 is aligned
+    static constexpr int32_t lead = (sizeof(T) <= alignment && alignment % sizeof(T) == 0) ? alignment / sizeof(T) : 1;
+
+    T* storage;
+    T* origin;
+    int32_t w;
+    int32_t h;
+    int32_t rowStride;
+
+    size_t storageSize() const {
+        return static_cast<size_t>(rowStride) * (h + 2);
+    }
+
+    void allocate(int32_t width, int32_t height) {
+        w = width;
+        h = height;
+        rowStride = ((lead + w + 1 + lead - 1) / lead) * lead;
+        storage = static_cast<T*>(::operator new(storageSize() * sizeof(T), std::align_val_t(alignment)));
+        origin = storage + rowStride + lead;
+    }
+
+    void release() {
+        if (storage) {
+            ::operator delete(storage, std::align_val_t(alignment));
+        }
+        storage = nullptr;
+        origin = nullptr;
+        w = 0;
+        h = 0;
+        rowStride = 0;
+    }
+
+public:
+    Grid() : storage(nullptr), origin(nullptr), w(0), h(0), rowStride(0) {}
+
+    Grid(int32_t width, int32_t height, const T& value = T()) {
+        allocate(width, height);
+        for (size_t i = 0; i < storageSize(); i ++) {
+            storage[i] = value;
+        }
+    }
+
+    Grid(const Grid& other) : storage(nullptr), origin(nullptr), w(0), h(0), rowStride(0) {
+        if (other.storage) {
+            allocate(other.w, other.h);
+            memcpy(storage, other.storage, storageSize() * sizeof(T));
+        }
+    }
+
+    Grid(Grid&& other) noexcept : storage(nullptr), origin(nullptr), w(0), h(0), rowStride(0) {
+        swap(other);
+    }
+
+    Grid& operator=(const Grid& other) {
+        if (this != &other) {
+            Grid copy(other);
+            swap(copy);
+        }
+        return *this;
+    }
+
+    Grid& operator=(Grid&& other) noexcept {
+        if (this != &other) {
+            release();
+            swap(other);
+        }
+        return *this;
+    }
+
+    ~Grid() {
+        release();
+    }
+
+    int32_t width() const {
+        return w;
+    }
+
+    int32_t height() const {
+        return h;
+    }
+
+    int32_t stride() const {
+        return rowStride;
+    }
+
+    bool contains(int32_t x, int32_t y) const {
+        return 0 <= x && x < w && 0 <= y && y < h;
+    }
+
+    T* operator[](int32_t y) {
+        return origin + static_cast<ptrdiff_t>(y) * rowStride;
+    }
+
+    const T* operator[](int32_t y) const {
+        return origin + static_cast<ptrdiff_t>(y) * rowStride;
+    }
+
+    T& operator()(int32_t x, int32_t y) {
+        return origin[static_cast<ptrdiff_t>(y) * rowStride + x];
+    }
+
+    const T& operator()(int32_t x, int32_t y) const {
+        return origin[static_cast<ptrdiff_t>(y) * rowStride + x];
+    }
+
+    // set every cell inside the grid, the halo is left untouched
+    void fill(const T& value) {
+        fillRows(0, h, value);
+    }
+
+    // set the cells of rows [y0, y1), the halo is left untouched
+    void fillRows(int32_t y0, int32_t y1, const T& value) {
+        for (int32_t y = y0; y < y1; y ++) {
+            T* row = (*this)[y];
+            for (int32_t x = 0; x < w; x ++) {
+                row[x] = value;
+            }
+        }
+    }
+
+    // set every halo cell, the cells inside the grid are left untouched
+    void fillHalo(const T& value) {
+        for (int32_t x = -1; x <= w; x ++) {
+            (*this)(x, -1) = value;
+            (*this)(x, h) = value;
+        }
+        for (int32_t y = 0; y < h; y ++) {
+            (*this)(-1, y) = value;
+            (*this)(w, y) = value;
+        }
+    }
+
+    // copy all cells and the halo of a grid with the same dimensions
+    void copyFrom(const Grid& other) {
+        memcpy(storage, other.storage, storageSize() * sizeof(T));
+    }
+
+    // copy rows [y0, y1) including their left and right halo cells
+    void copyRowsFrom(const Grid& other, int32_t y0, int32_t y1) {
+        for (int32_t y = y0; y < y1; y ++) {
+            memcpy((*this)[y] - 1, other[y] - 1, (w + 2) * sizeof(T));
+        }
+    }
+
+    void swap(Grid& other) noexcept {
+        std::swap(storage, other.storage);
+        std::swap(origin, other.origin);
+        std::swap(w, other.w);
+        std::swap(h, other.h);
+        std::swap(rowStride, other.rowStride);
+    }
+};
+
+#endif
@@ -0,0 +1,128 @@
+/**
+ * @file HeadlessGL.hpp
+ * @brief OpenGL core context without a window, through EGL
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#ifndef HEADLESSGL_HPP
+#define HEADLESSGL_HPP
+
+#include <cstdint>
+#include <string>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#ifndef __glew_h__
+#define GL_GLEXT_PROTOTYPES 1
+#include <GL/glcorearb.h>
+#endif
+
+/*
+HeadlessGL makes a desktop OpenGL core context current without any window
+or surface, for the tools and for CI machines without a GPU. It prefers
+Mesa's surfaceless platform, so llvmpipe works without X or a DRM device,
+and falls back to the default EGL display.
+
+The GL entry points are linked directly (libOpenGL with GLVND), so no
+loader has to run after create().
+*/
+class HeadlessGL {
+private:
+    EGLDisplay display;
+    EGLContext context;
+    std::string message;
+
+    bool fail(const std::string& what) {
+        message = what + " (EGL error 0x" + toHex(eglGetError()) + ")";
+        release();
+        return false;
+    }
+
+    static std::string toHex(EGLint value) {
+        const char* digits = "0123456789abcdef";
+        std::string text;
+        uint32_t bits = static_cast<uint32_t>(value);
+        do {
+            text.insert(text.begin(), digits[bits & 0xf]);
+            bits >>= 4;
+        } while (bits);
+        return text;
+    }
+
+    void release() {
+        if (display != EGL_NO_DISPLAY) {
+            eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            if (context != EGL_NO_CONTEXT) {
+                eglDestroyContext(display, context);
+            }
+            eglTerminate(display);
+        }
+        display = EGL_NO_DISPLAY;
+        context = EGL_NO_CONTEXT;
+    }
+
+public:
+    HeadlessGL() : display(EGL_NO_DISPLAY), context(EGL_NO_CONTEXT) {}
+
+    HeadlessGL(const HeadlessGL&) = delete;
+    HeadlessGL& operator=(const HeadlessGL&) = delete;
+
+    ~HeadlessGL() {
+        release();
+    }
+
+    // create a core profile context of at least major.minor and make it current
+    bool create(int32_t major, int32_t minor) {
+        release();
+
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay) {
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        }
+        if (display == EGL_NO_DISPLAY) {
+            display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        }
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+            display = EGL_NO_DISPLAY;
+            return fail("no EGL display");
+        }
+        if (!eglBindAPI(EGL_OPENGL_API)) {
+            return fail("EGL has no desktop OpenGL");
+        }
+
+        const EGLint attributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, major,
+            EGL_CONTEXT_MINOR_VERSION, minor,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+        if (context == EGL_NO_CONTEXT) {
+            return fail("failed to create an OpenGL " + std::to_string(major) + "." + std::to_string(minor) + " context");
+        }
+        if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+            return fail("failed to make the context current without a surface");
+        }
+        return true;
+    }
+
+    // why create() failed
+    const std::string& error() const {
+        return message;
+    }
+
+    std::string renderer() const {
+        const GLubyte* name = glGetString(GL_RENDERER);
+        const GLubyte* version = glGetString(GL_VERSION);
+        return std::string(name ? (const char*)name : "?") + ", OpenGL " + (version ? (const char*)version : "?");
+    }
+};
+
+#endif
@@ -0,0 +1,167 @@
+/**
+ * @file Materials.hpp
+ * @brief Material registry: density, phase, color and update rule of every cell type
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#ifndef MATERIALS_HPP
+#define MATERIALS_HPP
+
+#include <cstdint>
+#include <cstring>
+
+#include "Canvas.hpp"
+
+/*
+Every cell type is a row of Materials::table, in the order of Materials::ID.
+Adding a material is adding an ID and a row; the sweeps, the GPU shaders,
+the palettes and the PPM loader all read the table.
+
+phase       what the material is, for tools and the UI
+density     a powder sinks into any material of lower density that is not
+            static, the displaced material takes the powder's old place
+rule        the update rule the sweep dispatches to:
+            NONE    never moves (air)
+            STATIC  stays where it is (walls, stone)
+            POWDER  falls straight down or diagonally, by density
+            WATER   the water mass model of WaterKernel.hpp
+color       the draw color, RGBA
+
+The water mass model has exactly one gas and one liquid: mass that builds
+up in AIR turns it into WATER and water that drains turns back into AIR,
+and the water kernels only flow into those two. Further materials are
+static or powders, a static_assert below keeps it that way.
+
+The sweep does not look at the rows directly, it reads Materials::lookup,
+flat arrays over all 256 type bytes built from the table at compile time,
+so a dispatch is one load and a switch over the four rules however many
+materials there are.
+*/
+namespace Materials {
+    enum ID : int32_t {
+        AIR,
+        WALL,
+        SAND,
+        WATER,
+        STONE,
+        GRAVEL,
+        SAWDUST,
+        COUNT
+    };
+
+    enum class Phase : uint8_t {
+        GAS,
+        LIQUID,
+        POWDER,
+        STATIC
+    };
+
+    enum class Rule : uint8_t {
+        NONE,
+        STATIC,
+        POWDER,
+        WATER
+    };
+
+    struct Material {
+        const char* name;
+        Phase phase;
+        uint8_t density;
+        Rule rule;
+        uint8_t r;
+        uint8_t g;
+        uint8_t b;
+        uint8_t a;
+    };
+
+    constexpr Material table[COUNT] = {
+        {"air", Phase::GAS, 0, Rule::NONE, 0, 0, 0, 0},
+        {"wall", Phase::STATIC, 255, Rule::STATIC, 200, 200, 200, 255},
+        {"sand", Phase::POWDER, 160, Rule::POWDER, 200, 200, 50, 255},
+        {"water", Phase::LIQUID, 100, Rule::WATER, 0, 255, 255, 255},
+        {"stone", Phase::STATIC, 255, Rule::STATIC, 110, 110, 120, 255},
+        {"gravel", Phase::POWDER, 200, Rule::POWDER, 130, 115, 100, 255},
+        {"sawdust", Phase::POWDER, 60, Rule::POWDER, 190, 150, 100, 255}
+    };
+
+    // the table over every type byte, types without a row never move and are never displaced
+    struct Lookup {
+        Rule rule[256];
+        uint8_t density[256];
+        // a powder of density d moves into a cell of type t when yield[t] < d, 255 never yields
+        uint8_t yield[256];
+        // AIR and WATER, the types water flows into and mass turns into water in
+        bool fluid[256];
+    };
+
+    constexpr Lookup makeLookup() {
+        Lookup lookup = {};
+        for (int32_t i = 0; i < 256; i ++) {
+            lookup.rule[i] = Rule::NONE;
+            lookup.density[i] = 255;
+            lookup.yield[i] = 255;
+            lookup.fluid[i] = false;
+        }
+        for (int32_t i = 0; i < COUNT; i ++) {
+            const Material& material = table[i];
+            lookup.rule[i] = material.rule;
+            lookup.density[i] = material.density;
+            lookup.yield[i] = material.phase == Phase::STATIC ? 255 : material.density;
+            lookup.fluid[i] = material.phase == Phase::GAS || material.phase == Phase::LIQUID;
+        }
+        return lookup;
+    }
+
+    constexpr Lookup lookup = makeLookup();
+
+    constexpr bool registryValid() {
+        for (int32_t i = 0; i < COUNT; i ++) {
+            const Material& material = table[i];
+            bool fluid = material.phase == Phase::GAS || material.phase == Phase::LIQUID;
+            if (fluid != (i == AIR || i == WATER)) {
+                return false;
+            }
+            if ((material.rule == Rule::WATER) != (i == WATER) || (material.rule == Rule::NONE) != (i == AIR)) {
+                return false;
+            }
+            if (material.rule == Rule::POWDER && (material.phase != Phase::POWDER || material.density == 255)) {
+                return false;
+            }
+            if (material.rule == Rule::STATIC && material.phase != Phase::STATIC) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static_assert(registryValid(), "AIR is the only gas and WATER the only liquid, powders are lighter than 255");
+
+    inline const char* name(int32_t id) {
+        return id >= 0 && id < COUNT ? table[id].name : "unknown";
+    }
+
+    // the ID called name, false if there is none
+    inline bool find(const char* name, ID& id) {
+        for (int32_t i = 0; i < COUNT; i ++) {
+            if (strcmp(table[i].name, name) == 0) {
+                id = static_cast<ID>(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // the colors of all COUNT materials as Canvas::rgba(), for the palettes of the draw paths
+    inline void palette(uint32_t* colors) {
+        for (int32_t i = 0; i < COUNT; i ++) {
+            colors[i] = Canvas::rgba(table[i].r, table[i].g, table[i].b, table[i].a);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,374 @@
+/**
+ * @file Profiler.hpp
+ * @brief Scoped-timer profiler with nested zones, rolling stats and CSV / Chrome trace export
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+A Profiler measures the zones of one thread. A ProfileZone times the scope
+it lives in; zones opened inside it become its children, so the same name
+under two parents is two zones. Names are kept as pointers and must
+outlive the profiler, string literals are the intended use.
+
+Once per frame the owner calls endFrame(). The time every zone spent in
+that frame, summed over all of its calls, goes into a ring of the last
+window frames, and every refresh frames the min, average and 99th
+percentile over the ring are recomputed into statistics(). A zone that
+did not run in a frame, e.g. the fixed update of a frame without a step,
+does not count towards its stats.
+
+Profilers of several threads can share a ProfileLog, which writes a row
+per zone and frame to a CSV file and collects the individual calls for a
+Chrome trace (chrome://tracing or ui.perfetto.dev). Profilers hand their
+frame to the log in one locked call from endFrame(), never per zone.
+
+A ProfileZone of a null or disabled profiler costs one branch.
+*/
+class ProfileLog {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    struct TraceEvent {
+        const char* name;
+        uint32_t thread;
+        // microseconds since the log was created
+        double start;
+        double duration;
+    };
+
+    // calls past this many are not traced, a long session would otherwise grow without bound
+    static constexpr size_t maxTraceEvents = 1 << 22;
+
+private:
+    std::mutex mutex;
+    Clock::time_point origin;
+    FILE* csv;
+    bool tracing;
+    std::vector<TraceEvent> trace;
+    std::vector<std::pair<uint32_t, const char*>> threads;
+
+public:
+    ProfileLog() : origin(Clock::now()), csv(nullptr), tracing(false) {}
+
+    ProfileLog(const ProfileLog&) = delete;
+    ProfileLog& operator=(const ProfileLog&) = delete;
+
+    ~ProfileLog() {
+        if (csv) {
+            fclose(csv);
+        }
+    }
+
+    // write a row per zone and frame to path from now on, false if it can not be created
+    bool openCsv(const std::string& path) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (csv) {
+            fclose(csv);
+        }
+        csv = fopen(path.c_str(), "w");
+        if (!csv) {
+            return false;
+        }
+        fprintf(csv, "thread,frame,zone,depth,calls,ms\n");
+        return true;
+    }
+
+    // collect every zone call from now on for writeTrace()
+    void startTrace() {
+        std::lock_guard<std::mutex> lock(mutex);
+        tracing = true;
+    }
+
+    bool wantsTrace() const {
+        return tracing;
+    }
+
+    double microseconds(Clock::time_point time) const {
+        return std::chrono::duration<double, std::micro>(time - origin).count();
+    }
+
+    void nameThread(uint32_t thread, const char* name) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& named : threads) {
+            if (named.first == thread) {
+                named.second = name;
+                return;
+            }
+        }
+        threads.push_back(std::make_pair(thread, name));
+    }
+
+    // one frame of a profiler: its rows in CSV form and its traced calls
+    void frame(const std::string& rows, std::vector<TraceEvent>& events) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (csv && !rows.empty()) {
+            fwrite(rows.data(), 1, rows.size(), csv);
+        }
+        if (tracing && trace.size() < maxTraceEvents) {
+            size_t count = std::min(events.size(), maxTraceEvents - trace.size());
+            trace.insert(trace.end(), events.begin(), events.begin() + count);
+        }
+        events.clear();
+    }
+
+    // the collected calls as Chrome trace JSON, false if the file can not be written
+    bool writeTrace(const std::string& path) {
+        std::lock_guard<std::mutex> lock(mutex);
+        FILE* file = fopen(path.c_str(), "w");
+        if (!file) {
+            return false;
+        }
+        fprintf(file, "{\"traceEvents\":[\n");
+        bool first = true;
+        for (const auto& named : threads) {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", named.first, named.second);
+            first = false;
+        }
+        for (const TraceEvent& event : trace) {
+            fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                first ? "" : ",\n", event.name, event.thread, event.start, event.duration);
+            first = false;
+        }
+        fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+        return fclose(file) == 0;
+    }
+};
+
+class Profiler {
+public:
+    typedef ProfileLog::Clock Clock;
+
+    // milliseconds per frame over the window
+    struct Stats {
+        const char* name = "";
+        int32_t depth = 0;
+        // calls and time in the last frame the zone ran
+        int32_t calls = 0;
+        double last = 0.0;
+        double min = 0.0;
+        double avg = 0.0;
+        double p99 = 0.0;
+    };
+
+private:
+    struct Zone {
+        const char* name;
+        int32_t parent;
+        int32_t depth;
+        // this frame
+        Clock::duration time;
+        int32_t calls;
+        int32_t lastCalls;
+        // the last window frames the zone ran in, in ms
+        std::vector<float> history;
+        int32_t historySize;
+        int32_t historyNext;
+    };
+
+    struct Open {
+        int32_t zone;
+        Clock::time_point start;
+    };
+
+    const char* threadName;
+    uint32_t threadId;
+    int32_t window;
+    int32_t refresh;
+    bool active;
+    ProfileLog* log;
+
+    std::vector<Zone> zones;
+    std::vector<Open> stack;
+    std::vector<Stats> stats;
+    int32_t framesSinceRefresh;
+    uint64_t frames;
+    std::vector<ProfileLog::TraceEvent> traced;
+    std::string rows;
+    std::vector<float> sorted;
+
+    int32_t find(const char* name, int32_t parent) {
+        for (size_t i = 0; i < zones.size(); i ++) {
+            const Zone& zone = zones[i];
+            if (zone.parent == parent && (zone.name == name || strcmp(zone.name, name) == 0)) {
+                return static_cast<int32_t>(i);
+            }
+        }
+        Zone zone;
+        zone.name = name;
+        zone.parent = parent;
+        zone.depth = parent < 0 ? 0 : zones[parent].depth + 1;
+        zone.time = Clock::duration::zero();
+        zone.calls = 0;
+        zone.lastCalls = 0;
+        zone.history.assign(window, 0.0f);
+        zone.historySize = 0;
+        zone.historyNext = 0;
+        zones.push_back(zone);
+        return static_cast<int32_t>(zones.size() - 1);
+    }
+
+    // children follow their parent, in the order they first ran
+    void appendStats(int32_t parent) {
+        for (size_t i = 0; i < zones.size(); i ++) {
+            const Zone& zone = zones[i];
+            if (zone.parent != parent) {
+                continue;
+            }
+            Stats entry;
+            entry.name = zone.name;
+            entry.depth = zone.depth;
+            entry.calls = zone.lastCalls;
+            if (zone.historySize > 0) {
+                sorted.assign(zone.history.begin(), zone.history.begin() + zone.historySize);
+                double sum = 0.0;
+                for (float ms : sorted) {
+                    sum += ms;
+                }
+                size_t rank = (sorted.size() * 99 + 99) / 100 - 1;
+                std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+                entry.p99 = sorted[rank];
+                entry.min = *std::min_element(sorted.begin(), sorted.end());
+                entry.avg = sum / sorted.size();
+                entry.last = zone.history[(zone.historyNext + window - 1) % window];
+            }
+            stats.push_back(entry);
+            appendStats(static_cast<int32_t>(i));
+        }
+    }
+
+public:
+    // thread names the profiler in logs, window is the number of frames the stats cover
+    explicit Profiler(const char* thread = "main", uint32_t threadId = 0, int32_t window = 240, int32_t refresh = 30)
+        : threadName(thread), threadId(threadId), window(std::max(window, 1)), refresh(std::max(refresh, 1)),
+          active(true), log(nullptr), framesSinceRefresh(0), frames(0) {}
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    bool enabled() const {
+        return active;
+    }
+
+    void setEnabled(bool enabled) {
+        active = enabled;
+    }
+
+    // share frames with log, nullptr to stop
+    void setLog(ProfileLog* into) {
+        log = into;
+        if (log) {
+            log->nameThread(threadId, threadName);
+        }
+    }
+
+    // open a zone as a child of the innermost open one
+    int32_t begin(const char* name) {
+        int32_t zone = find(name, stack.empty() ? -1 : stack.back().zone);
+        Open open;
+        open.zone = zone;
+        open.start = Clock::now();
+        stack.push_back(open);
+        return zone;
+    }
+
+    // close the innermost zone
+    void end() {
+        Clock::time_point now = Clock::now();
+        Open open = stack.back();
+        stack.pop_back();
+        Zone& zone = zones[open.zone];
+        zone.time += now - open.start;
+        zone.calls ++;
+        if (log && log->wantsTrace()) {
+            ProfileLog::TraceEvent event;
+            event.name = zone.name;
+            event.thread = threadId;
+            event.start = log->microseconds(open.start);
+            event.duration = std::chrono::duration<double, std::micro>(now - open.start).count();
+            traced.push_back(event);
+        }
+    }
+
+    // close the frame, zones still open count towards the next one
+    void endFrame() {
+        rows.clear();
+        for (Zone& zone : zones) {
+            if (zone.calls == 0) {
+                continue;
+            }
+            float ms = std::chrono::duration<float, std::milli>(zone.time).count();
+            zone.history[zone.historyNext] = ms;
+            zone.historyNext = (zone.historyNext + 1) % window;
+            zone.historySize = std::min(zone.historySize + 1, window);
+            zone.lastCalls = zone.calls;
+            if (log) {
+                char row[160];
+                int length = snprintf(row, sizeof(row), "%s,%llu,%s,%d,%d,%.4f\n", threadName,
+                    static_cast<unsigned long long>(frames), zone.name, zone.depth, zone.calls, ms);
+                rows.append(row, std::min(static_cast<size_t>(std::max(length, 0)), sizeof(row) - 1));
+            }
+            zone.time = Clock::duration::zero();
+            zone.calls = 0;
+        }
+        if (log) {
+            log->frame(rows, traced);
+        }
+        frames ++;
+
+        if (++ framesSinceRefresh >= refresh || stats.empty()) {
+            framesSinceRefresh = 0;
+            stats.clear();
+            appendStats(-1);
+        }
+    }
+
+    // every zone in tree order, refreshed every refresh frames
+    const std::vector<Stats>& statistics() const {
+        return stats;
+    }
+
+    uint64_t frameCount() const {
+        return frames;
+    }
+};
+
+class ProfileZone {
+private:
+    Profiler* profiler;
+
+public:
+    ProfileZone(Profiler* profiler, const char* name) : profiler(profiler && profiler->enabled() ? profiler : nullptr) {
+        if (this->profiler) {
+            this->profiler->begin(name);
+        }
+    }
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+    ~ProfileZone() {
+        if (profiler) {
+            profiler->end();
+        }
+    }
+};
+
+#endif
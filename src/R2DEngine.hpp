@@ -15,6 +15,7 @@
 
 // standard libraries
 #include <cstdint>
+#include <cstdio>
 #include <cmath>
 #include <string>
 #include <cstring>
@@ -28,6 +29,17 @@
 #include <list>
 #include <map>
 #include <algorithm>
+#include <thread>
+
+#include "Canvas.hpp"
+#include "FileWatcher.hpp"
+#include "Profiler.hpp"
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
 
 #if USE_OPENGL
 // opengl related
@@ -186,6 +198,17 @@ private:
     GLuint bufferTexture;
     GLubyte* bufferData;
     GLuint vao, ibo, vbo;
+    // persistently mapped pixel unpack buffer, one slice per frame in flight
+    static constexpr int32_t uploadSlices = 3;
+    GLuint uploadBuffer;
+    GLubyte* uploadData;
+    size_t uploadSliceSize;
+    int32_t uploadSlice;
+    GLsync uploadFences[uploadSlices];
+    // shader files of init(), the program is rebuilt when one of them is written
+    std::string vertexPath;
+    std::string fragmentPath;
+    FileWatcher shaderWatcher;
 #elif USE_SDL2
     SDL_Window* window;
     SDL_Renderer* renderer;
@@ -198,6 +221,20 @@ private:
     SDL_Event event;
 #endif
 
+    // fixed timestep
+    double stepAccumulator;
+    int64_t stepCount;
+    int64_t droppedSteps;
+    // steps run during the last rateWindow seconds, for the window title
+    double rateTime;
+    int64_t rateSteps;
+    double stepRate;
+
+    // profiler overlay, the pixels it covers are put back after the upload
+    std::vector<uint32_t> overlayUnder;
+    bool overlayKeyHeld;
+    std::string profileTracePath;
+
 protected:
     // game
     struct Coord {
@@ -212,6 +249,18 @@ protected:
         uint8_t b = 0;
         uint8_t a = 255;
         Color(uint8_t r = 0, uint8_t g = 0, uint8_t b = 0, uint8_t a = 255) : r(r), g(g), b(b), a(a) {}
+        // packed pixel as stored in bufferData
+        uint32_t pixel() const {
+            return Canvas::rgba(r, g, b, a);
+        }
+    };
+
+    struct Rect {
+        int32_t x = 0;
+        int32_t y = 0;
+        int32_t w = 0;
+        int32_t h = 0;
+        Rect(int32_t x = 0, int32_t y = 0, int32_t w = 0, int32_t h = 0) : x(x), y(y), w(w), h(h) {}
     };
     
     // graphics
@@ -220,10 +269,44 @@ protected:
     int32_t innerWidth;
     int32_t innerHeight;
     std::string windowTitle;
+    // OpenGL version requested by construct(), raise it before construct() for newer features
+    int32_t glVersionMajor;
+    int32_t glVersionMinor;
+    // clear bufferData before every onUpdate and upload the whole frame,
+    // turn off to only redraw and upload the regions passed to markDirty()
+    bool clearFrame;
+    // view of bufferData for the bulk drawing calls
+    Canvas canvas;
+
+    // scheduler
+    // seconds simulated by one onFixedUpdate, 0 turns the fixed steps off
+    double fixedStep;
+    // most onFixedUpdate calls per frame, time beyond that is dropped so a
+    // slow step can not make every following frame slower
+    int32_t maxSubSteps;
+    // frames shorter than this sleep for the rest, without vsync it caps the frame rate
+    double minFrameTime;
 #if USE_OPENGL
     GLuint shader;
+    // directory of linked program binaries keyed by their sources, a start with
+    // unchanged shaders skips compiling them, empty turns the cache off
+    std::string shaderCacheDir;
+    // rebuild the program while running when its shader files are written
+    bool reloadShaders;
 #endif
 
+    // profiler
+    // zones of the game loop, derived classes can open their own zones inside them
+    Profiler profiler;
+    // CSV and trace output of profileToCsv() and profileToTrace(), profilers of other threads can share it
+    ProfileLog profileLog;
+    bool profileLogging;
+    // draw the zone stats over the frame, toggled with F3
+    bool showProfile;
+    // more stats for the overlay, e.g. of a simulation thread, listed under their own heading
+    const char* extraProfileTitle;
+    std::vector<Profiler::Stats> extraProfile;
+
     // events
     enum InputState {
         UNKNOWN,
@@ -233,17 +316,49 @@ protected:
     };
     double mousePosX;
     double mousePosY;
-    
+
+private:
+    // regions of bufferData changed since the last upload
+    std::vector<Rect> dirtyRegions;
+    Rect overlayRect;
+
 private:
     void gameLoop();
 
+    double now() const;
+    void waitForFrame(double frameStart);
+    // window title, input state and the close request
+    void pollEvents(double deltaTime);
+    bool runFixedSteps(double deltaTime);
+
     void clearBuffer();
+    void uploadFrame();
     void swapBuffers();
+    void drawProfile();
+    void restoreProfile();
 
 #if USE_OPENGL
+    // file of the cache, the binary follows, the key is checked against the name
+    struct ProgramBinaryHeader {
+        char magic[8];
+        uint64_t key;
+        uint32_t format;
+        uint32_t size;
+    };
+
     std::string importShader(const char* shaderPath);
-    void addShader(GLuint program, const char* shaderCode, GLenum shaderType);
-    void compileShaders(const char* vCode, const char* fCode);
+    bool addShader(GLuint program, const char* shaderCode, GLenum shaderType);
+    // linked program of the sources, from the cache if it is there, 0 if they do not build
+    GLuint buildProgram(const std::string& vCode, const std::string& fCode);
+    GLuint compileProgram(const char* vCode, const char* fCode, bool retrievable);
+    // FNV-1a over the sources and the driver, a binary only loads into the driver that made it
+    uint64_t programKey(const std::string& vCode, const std::string& fCode) const;
+    bool programBinaries() const;
+    std::string programCachePath(uint64_t key) const;
+    GLuint loadProgramBinary(uint64_t key);
+    void saveProgramBinary(uint64_t key, GLuint program);
+    // swap in the program of the changed shader files, the old one stays if they do not build
+    void reloadChangedShaders();
 #endif
 
 public:
@@ -254,14 +369,53 @@ public:
     // user interfaces
     virtual bool onCreate() = 0;
     virtual bool onUpdate(double deltaTime) = 0;
+    // called every fixedStep seconds of game time, before onUpdate of the same frame
+    virtual bool onFixedUpdate(double /*step*/) {
+        return true;
+    }
     virtual bool onDestroy() {
         return true;
     }
+#if USE_OPENGL
+    // shader is a new program, uniform locations and values must be set again
+    virtual void onShaderReload() {}
+#endif
 
 public:
     // game
     bool construct(int32_t screenWidth = 800, int32_t screenHeight = 600, int32_t innerWidth = 800, int32_t innerHeight = 600);
-    void init(const char* vShaderPath = "", const char* fShaderPath = "");
+    // runs the game loop, false without running it if the shaders fail to build
+    bool init(const char* vShaderPath = "", const char* fShaderPath = "");
+
+#if USE_OPENGL
+    // RGBA8 texture presented every frame, it can also be written by shaders
+    GLuint frameTexture() const {
+        return bufferTexture;
+    }
+#endif
+
+public:
+    // scheduler
+    // fraction of a fixed step that is left over, for interpolating the drawn state
+    double stepInterpolation() const {
+        return fixedStep > 0.0 ? stepAccumulator / fixedStep : 0.0;
+    }
+
+    // onFixedUpdate calls so far, and fixed steps dropped to keep up
+    int64_t fixedSteps() const {
+        return stepCount;
+    }
+
+    int64_t skippedSteps() const {
+        return droppedSteps;
+    }
+
+public:
+    // profiler
+    // write every frame's zone times to path, false if it can not be created
+    bool profileToCsv(const std::string& path);
+    // write the zone calls as a Chrome trace to path when the game loop ends
+    void profileToTrace(const std::string& path);
 
 public:
     // events
@@ -273,6 +427,13 @@ public:
     // graphics
     void drawPoint(Coord coord, Color color);
     void drawLine(Coord coord1, Coord coord2, Color color);
+    void drawSpan(Coord coord, int32_t length, Color color);
+    void fillRect(Rect rect, Color color);
+    void blitRow(Coord coord, const uint32_t* pixels, int32_t count);
+    // palette[indices[i]] for a rect of indices, row r starts at indices + r * stride
+    void blitIndexed(Rect rect, const int32_t* indices, ptrdiff_t stride, const uint32_t* palette, int32_t paletteSize);
+    // upload the region with the next frame, only needed when clearFrame is off
+    void markDirty(Rect rect);
 };
 
 #if USE_OPENGL
@@ -295,6 +456,13 @@ R2DEngine::R2DEngine() {
     ibo = 0;
     bufferData = nullptr;
     bufferTexture = 0;
+    uploadBuffer = 0;
+    uploadData = nullptr;
+    uploadSliceSize = 0;
+    uploadSlice = 0;
+    for (int32_t i = 0; i < uploadSlices; i ++) {
+        uploadFences[i] = nullptr;
+    }
 #elif USE_SDL2
     window = nullptr;
     renderer = nullptr;
@@ -307,6 +475,28 @@ R2DEngine::R2DEngine() {
     innerWidth = 0;
     innerHeight = 0;
     windowTitle = "R2DEngine";
+    glVersionMajor = 3;
+    glVersionMinor = 3;
+#if USE_OPENGL
+    shaderCacheDir = "./shaders/cache";
+    reloadShaders = true;
+#endif
+
+    fixedStep = 0.0;
+    maxSubSteps = 8;
+    minFrameTime = 0.001;
+    stepAccumulator = 0.0;
+    stepCount = 0;
+    droppedSteps = 0;
+    rateTime = 0.0;
+    rateSteps = 0;
+    stepRate = 0.0;
+    clearFrame = true;
+
+    overlayKeyHeld = false;
+    profileLogging = false;
+    showProfile = false;
+    extraProfileTitle = "";
 }
 
 R2DEngine::~R2DEngine() {}
@@ -322,8 +512,8 @@ bool R2DEngine::construct(int32_t screenWidth, int32_t screenHeight, int32_t inn
         DEBUG_ERROR("Failed to initialize GLFW");
         return false;
     }
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, glVersionMajor);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, glVersionMinor);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 
@@ -337,6 +527,8 @@ bool R2DEngine::construct(int32_t screenWidth, int32_t screenHeight, int32_t inn
     }
     glfwMakeContextCurrent(window);
 
+    // core profile entry points are only loaded with glewExperimental
+    glewExperimental = GL_TRUE;
     if (glewInit() != GLEW_OK) {
         DEBUG_ERROR("Failed to initialize GLEW");
         glfwDestroyWindow(window);
@@ -361,15 +553,34 @@ bool R2DEngine::construct(int32_t screenWidth, int32_t screenHeight, int32_t inn
 
     bufferData = new GLubyte[innerWidth * innerHeight * 4];
     memset(bufferData, 0, sizeof(GLubyte) * innerWidth * innerHeight * 4);
+    canvas = Canvas(bufferData, innerWidth, innerHeight);
     glGenTextures(1, &bufferTexture);
     glBindTexture(GL_TEXTURE_2D, bufferTexture);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, innerWidth, innerHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid*)bufferData);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, innerWidth, innerHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid*)bufferData);
     glBindTexture(GL_TEXTURE_2D, 0);
 
+    // dirty regions are copied into a persistently mapped buffer and the
+    // texture is updated from there, without one more copy in the driver,
+    // fences keep us from overwriting a slice the GPU still reads from
+    if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) {
+        uploadSliceSize = static_cast<size_t>(innerWidth) * innerHeight * 4;
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glGenBuffers(1, &uploadBuffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBuffer);
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, uploadSliceSize * uploadSlices, nullptr, flags);
+        uploadData = (GLubyte*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, uploadSliceSize * uploadSlices, flags);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if (!uploadData) {
+            DEBUG_MSG("persistent mapping failed, uploading from client memory");
+            glDeleteBuffers(1, &uploadBuffer);
+            uploadBuffer = 0;
+        }
+    }
+
     GLfloat vertices[] = {
         -1.0f, 1.0f,    0.0f, 0.0f,
         1.0f, 1.0f,     1.0f, 0.0f,
@@ -437,50 +648,222 @@ bool R2DEngine::construct(int32_t screenWidth, int32_t screenHeight, int32_t inn
     );
     bufferData = new uint8_t[innerWidth * innerHeight * 4];
     memset(bufferData, 0, sizeof(uint8_t) * innerWidth * innerHeight * 4);
+    canvas = Canvas(bufferData, innerWidth, innerHeight);
 #endif
 
     return true;
 }
 
-void R2DEngine::init(const char* vShaderPath, const char* fShaderPath) {
+bool R2DEngine::init(const char* vShaderPath, const char* fShaderPath) {
     DEBUG_MSG("init");
 
+    vertexPath = vShaderPath;
+    fragmentPath = fShaderPath;
     std::string v = importShader(vShaderPath);
     std::string f = importShader(fShaderPath);
-
-    const char* vCode = v.c_str();
-    const char* fCode = f.c_str();
-    if (vCode[0] == '\0') {
-        vCode = vShader;
+    if (v.empty()) {
+        v = vShader;
     }
-    if (fCode[0] == '\0') {
-        fCode = fShader;
+    if (f.empty()) {
+        f = fShader;
+    }
+    shader = buildProgram(v, f);
+    if (!shader) {
+        // the app sets uniforms and samplers of its own shaders, the defaults have none of them
+        DEBUG_ERROR("the shaders failed to build");
+        return false;
     }
-    compileShaders(vCode, fCode);
     glUseProgram(shader);
-    DEBUG_MSG("shaders compiled");
+    DEBUG_MSG("shaders ready");
+
+    if (reloadShaders && !vertexPath.empty() && !fragmentPath.empty()) {
+        if (!shaderWatcher.watch(vertexPath) || !shaderWatcher.watch(fragmentPath)) {
+            DEBUG_MSG("shader files can not be watched, no hot reload");
+        }
+    }
 
     loop = true;
     gameLoop();
+    return true;
 }
 
 void R2DEngine::clearBuffer() {
 #if USE_OPENGL
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
-    memset(bufferData, 0, sizeof(GLubyte) * innerWidth * innerHeight * 4);
+    if (clearFrame) {
+        memset(bufferData, 0, sizeof(GLubyte) * innerWidth * innerHeight * 4);
+    }
 #elif USE_SDL2
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
     SDL_RenderClear(renderer);
-    memset(bufferData, 0, sizeof(uint8_t) * innerWidth * innerHeight * 4);
+    if (clearFrame) {
+        memset(bufferData, 0, sizeof(uint8_t) * innerWidth * innerHeight * 4);
+    }
+#endif
+}
+
+void R2DEngine::markDirty(Rect rect) {
+    int32_t x0 = std::max(rect.x, 0);
+    int32_t y0 = std::max(rect.y, 0);
+    int32_t x1 = std::min(rect.x + rect.w, innerWidth);
+    int32_t y1 = std::min(rect.y + rect.h, innerHeight);
+    if (x0 < x1 && y0 < y1) {
+        dirtyRegions.push_back(Rect(x0, y0, x1 - x0, y1 - y0));
+    }
+}
+
+void R2DEngine::uploadFrame() {
+    if (clearFrame) {
+        dirtyRegions.clear();
+        dirtyRegions.push_back(Rect(0, 0, innerWidth, innerHeight));
+    }
+    if (dirtyRegions.empty()) {
+        return;
+    }
+
+    // past half the frame one upload is cheaper than many small ones
+    size_t area = 0;
+    for (const Rect& rect : dirtyRegions) {
+        area += static_cast<size_t>(rect.w) * rect.h;
+    }
+    if (area * 2 >= static_cast<size_t>(innerWidth) * innerHeight) {
+        dirtyRegions.clear();
+        dirtyRegions.push_back(Rect(0, 0, innerWidth, innerHeight));
+    }
+
+#if USE_OPENGL
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, bufferTexture);
+    if (uploadData) {
+        GLsync& fence = uploadFences[uploadSlice];
+        if (fence) {
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+
+        // regions are packed one after another, they fit in a slice since
+        // anything over half the frame was merged into one full upload
+        size_t offset = uploadSliceSize * uploadSlice;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBuffer);
+        for (const Rect& rect : dirtyRegions) {
+            size_t rowSize = static_cast<size_t>(rect.w) * 4;
+            for (int32_t y = 0; y < rect.h; y ++) {
+                memcpy(uploadData + offset + y * rowSize, bufferData + ((rect.y + y) * innerWidth + rect.x) * 4, rowSize);
+            }
+            glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x, rect.y, rect.w, rect.h, GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid*)offset);
+            offset += rowSize * rect.h;
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        uploadSlice = (uploadSlice + 1) % uploadSlices;
+    } else {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, innerWidth);
+        for (const Rect& rect : dirtyRegions) {
+            glPixelStorei(GL_UNPACK_SKIP_PIXELS, rect.x);
+            glPixelStorei(GL_UNPACK_SKIP_ROWS, rect.y);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x, rect.y, rect.w, rect.h, GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid*)bufferData);
+        }
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    }
+#elif USE_SDL2
+    for (const Rect& rect : dirtyRegions) {
+        SDL_Rect region = {rect.x, rect.y, rect.w, rect.h};
+        SDL_UpdateTexture(bufferTexture, &region, (void*)(bufferData + (rect.y * innerWidth + rect.x) * 4), innerWidth * 4);
+    }
 #endif
+    dirtyRegions.clear();
+}
+
+bool R2DEngine::profileToCsv(const std::string& path) {
+    if (!profileLog.openCsv(path)) {
+        return false;
+    }
+    profileLogging = true;
+    profiler.setLog(&profileLog);
+    return true;
+}
+
+void R2DEngine::profileToTrace(const std::string& path) {
+    profileTracePath = path;
+    profileLog.startTrace();
+    profileLogging = true;
+    profiler.setLog(&profileLog);
+}
+
+void R2DEngine::drawProfile() {
+    std::vector<std::string> lines;
+    auto number = [](double ms) {
+        char text[16];
+        snprintf(text, sizeof(text), ms < 10.0 ? " %4.2f" : ms < 100.0 ? " %4.1f" : " %4.0f", ms);
+        return std::string(text);
+    };
+    auto section = [&](const char* title, const std::vector<Profiler::Stats>& stats) {
+        lines.push_back(std::string(title) + std::string(std::max(0, 11 - static_cast<int32_t>(strlen(title))), ' ') + "  AVG   MIN   P99");
+        for (const Profiler::Stats& zone : stats) {
+            std::string name = std::string(zone.depth, ' ') + zone.name;
+            name.resize(11, ' ');
+            lines.push_back(name + number(zone.avg) + number(zone.min) + number(zone.p99));
+        }
+    };
+    section("MS", profiler.statistics());
+    if (!extraProfile.empty()) {
+        section(extraProfileTitle, extraProfile);
+    }
+
+    size_t columns = 0;
+    for (const std::string& line : lines) {
+        columns = std::max(columns, line.size());
+    }
+    int32_t x1 = std::min(static_cast<int32_t>(columns) * Canvas::glyphWidth + 1, innerWidth);
+    int32_t y1 = std::min(static_cast<int32_t>(lines.size()) * Canvas::glyphHeight + 1, innerHeight);
+
+    // the region of the last overlay shows the restored pixels again, the new one the overlay
+    markDirty(overlayRect);
+    overlayRect = Rect(0, 0, x1, y1);
+    markDirty(overlayRect);
+    overlayUnder.resize(static_cast<size_t>(x1) * y1);
+    for (int32_t y = 0; y < y1; y ++) {
+        memcpy(&overlayUnder[static_cast<size_t>(y) * x1], canvas[y], x1 * sizeof(uint32_t));
+    }
+
+    canvas.fillRect(0, 0, x1, y1, Color(0, 0, 0).pixel());
+    for (size_t i = 0; i < lines.size(); i ++) {
+        canvas.text(1, 1 + static_cast<int32_t>(i) * Canvas::glyphHeight, lines[i].c_str(), Color(255, 255, 255).pixel());
+    }
+}
+
+void R2DEngine::restoreProfile() {
+    for (int32_t y = 0; y < overlayRect.h; y ++) {
+        memcpy(canvas[y], &overlayUnder[static_cast<size_t>(y) * overlayRect.w], overlayRect.w * sizeof(uint32_t));
+    }
 }
 
 void R2DEngine::swapBuffers() {
+    bool overlay = showProfile;
+    if (overlay) {
+        ProfileZone zone(&profiler, "overlay");
+        drawProfile();
+    } else if (overlayRect.w > 0) {
+        markDirty(overlayRect);
+        overlayRect = Rect();
+    }
+    {
+        ProfileZone zone(&profiler, "upload");
+        uploadFrame();
+    }
+    if (overlay) {
+        restoreProfile();
+    }
+
+    ProfileZone zone(&profiler, "present");
 #if USE_OPENGL
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, bufferTexture);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, innerWidth, innerHeight, GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid*)bufferData);
-    
+
     glBindVertexArray(vao);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
@@ -488,7 +871,6 @@ void R2DEngine::swapBuffers() {
     glBindVertexArray(0);
     glfwSwapBuffers(window);
 #elif USE_SDL2
-    SDL_UpdateTexture(bufferTexture, nullptr, (void*)bufferData, innerWidth * 4);
     SDL_RenderCopy(renderer,  bufferTexture, nullptr, nullptr);
     SDL_RenderPresent(renderer);
 #endif
@@ -496,8 +878,7 @@ void R2DEngine::swapBuffers() {
 
 #if USE_OPENGL
 std::string R2DEngine::importShader(const char* shaderPath) {
-    std::string content;
-    std::ifstream fileStream(shaderPath, std::ios::in);
+    std::ifstream fileStream(shaderPath, std::ios::in | std::ios::binary);
 
     if (!fileStream.is_open()) {
         DEBUG_ERROR("Failed to read shader:");
@@ -505,17 +886,12 @@ std::string R2DEngine::importShader(const char* shaderPath) {
         return "";
     }
 
-    std::string line = "";
-    while (!fileStream.eof()) {
-        std::getline(fileStream, line);
-        content.append(line + "\n");
-    }
-
-    fileStream.close();
-    return content;
+    std::stringstream content;
+    content << fileStream.rdbuf();
+    return content.str();
 }
 
-void R2DEngine::addShader(GLuint program, const char* shaderCode, GLenum shaderType) {
+bool R2DEngine::addShader(GLuint program, const char* shaderCode, GLenum shaderType) {
     GLuint shader = glCreateShader(shaderType);
 
     const GLchar *theCode[1];
@@ -534,115 +910,345 @@ void R2DEngine::addShader(GLuint program, const char* shaderCode, GLenum shaderT
         GLchar log[1024] = {0};
         glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
         DEBUG_ERROR(log);
-        return;
+        glDeleteShader(shader);
+        return false;
     }
     glAttachShader(program, shader);
+    // freed with the program
+    glDeleteShader(shader);
+    return true;
 }
 
-void R2DEngine::compileShaders(const char* vCode, const char* fCode) {
-    shader = glCreateProgram();
-    if (!shader) {
+GLuint R2DEngine::compileProgram(const char* vCode, const char* fCode, bool retrievable) {
+    GLuint program = glCreateProgram();
+    if (!program) {
         DEBUG_ERROR("failed to create shader program");
-        return;
+        return 0;
     }
 
-    addShader(shader, vCode, GL_VERTEX_SHADER);
-    addShader(shader, fCode, GL_FRAGMENT_SHADER);
+    if (!addShader(program, vCode, GL_VERTEX_SHADER) || !addShader(program, fCode, GL_FRAGMENT_SHADER)) {
+        glDeleteProgram(program);
+        return 0;
+    }
 
-    glLinkProgram(shader);
+    if (retrievable) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+    glLinkProgram(program);
 
     GLint test;
-    glGetProgramiv(shader, GL_LINK_STATUS, &test);
+    glGetProgramiv(program, GL_LINK_STATUS, &test);
     if (!test) {
         DEBUG_ERROR("failed to link program:");
         GLchar log[1024] = {0};
-        glGetProgramInfoLog(shader, sizeof(log), nullptr, log);
+        glGetProgramInfoLog(program, sizeof(log), nullptr, log);
         DEBUG_ERROR(log);
-        return;
+        glDeleteProgram(program);
+        return 0;
     }
 
-    glValidateProgram(shader);
+    glValidateProgram(program);
 
-    glGetProgramiv(shader, GL_VALIDATE_STATUS, &test);
+    glGetProgramiv(program, GL_VALIDATE_STATUS, &test);
     if (!test) {
         DEBUG_ERROR("failed to validate program:");
         GLchar log[1024] = {0};
-        glGetProgramInfoLog(shader, sizeof(log), nullptr, log);
+        glGetProgramInfoLog(program, sizeof(log), nullptr, log);
         DEBUG_ERROR(log);
+    }
+    return program;
+}
+
+bool R2DEngine::programBinaries() const {
+    if (shaderCacheDir.empty() || !(GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)) {
+        return false;
+    }
+    // drivers may support the calls without any format to save in
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+uint64_t R2DEngine::programKey(const std::string& vCode, const std::string& fCode) const {
+    uint64_t hash = 14695981039346656037ull;
+    auto add = [&hash](const char* text) {
+        // the terminating 0 too, so "ab" + "c" and "a" + "bc" differ
+        do {
+            hash = (hash ^ static_cast<uint8_t>(*text)) * 1099511628211ull;
+        } while (*text ++);
+    };
+    add(vCode.c_str());
+    add(fCode.c_str());
+    const GLenum driver[3] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+    for (GLenum name : driver) {
+        const GLubyte* text = glGetString(name);
+        add(text ? (const char*)text : "");
+    }
+    return hash;
+}
+
+std::string R2DEngine::programCachePath(uint64_t key) const {
+    char name[17];
+    snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+    return shaderCacheDir + "/" + name + ".bin";
+}
+
+GLuint R2DEngine::loadProgramBinary(uint64_t key) {
+    std::ifstream file(programCachePath(key), std::ios::in | std::ios::binary);
+    if (!file.is_open()) {
+        return 0;
+    }
+    ProgramBinaryHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || memcmp(header.magic, "R2DPROG1", 8) != 0 || header.key != key) {
+        return 0;
+    }
+    // the binary is the rest of the file, a truncated or corrupt size is compiled again instead of allocated
+    std::streamoff start = file.tellg();
+    file.seekg(0, std::ios::end);
+    std::streamoff end = file.tellg();
+    if (start < 0 || header.size == 0 || end - start != static_cast<std::streamoff>(header.size)) {
+        return 0;
+    }
+    file.seekg(start);
+    std::vector<char> binary(header.size);
+    if (!file.read(binary.data(), binary.size())) {
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.format, binary.data(), header.size);
+    GLint test;
+    glGetProgramiv(program, GL_LINK_STATUS, &test);
+    if (!test) {
+        // e.g. a driver update, the binary is compiled again and overwritten
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+void R2DEngine::saveProgramBinary(uint64_t key, GLuint program) {
+    GLint size = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+    if (size <= 0) {
+        return;
+    }
+    ProgramBinaryHeader header;
+    memcpy(header.magic, "R2DPROG1", 8);
+    header.key = key;
+    std::vector<char> binary(size);
+    GLenum format = 0;
+    glGetProgramBinary(program, size, nullptr, &format, binary.data());
+    header.format = format;
+    header.size = static_cast<uint32_t>(size);
+
+#ifdef _WIN32
+    _mkdir(shaderCacheDir.c_str());
+#else
+    mkdir(shaderCacheDir.c_str(), 0755);
+#endif
+    // written aside and renamed, another instance starting at the same time never reads half a file
+    std::string path = programCachePath(key);
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!file.write(reinterpret_cast<const char*>(&header), sizeof(header)) || !file.write(binary.data(), binary.size())) {
+            DEBUG_ERROR(("can not write " + temporary).c_str());
+            return;
+        }
+    }
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+    }
+}
+
+GLuint R2DEngine::buildProgram(const std::string& vCode, const std::string& fCode) {
+    bool cached = programBinaries();
+    uint64_t key = cached ? programKey(vCode, fCode) : 0;
+    if (cached) {
+        GLuint program = loadProgramBinary(key);
+        if (program) {
+            DEBUG_MSG("shaders loaded from the cache");
+            return program;
+        }
+    }
+    GLuint program = compileProgram(vCode.c_str(), fCode.c_str(), cached);
+    if (program && cached) {
+        saveProgramBinary(key, program);
+    }
+    return program;
+}
+
+void R2DEngine::reloadChangedShaders() {
+    if (!shaderWatcher.changed()) {
         return;
     }
+    std::string v = importShader(vertexPath.c_str());
+    std::string f = importShader(fragmentPath.c_str());
+    GLuint program = v.empty() || f.empty() ? 0 : buildProgram(v, f);
+    if (!program) {
+        DEBUG_ERROR("shaders not reloaded, keeping the running ones");
+        return;
+    }
+    glUseProgram(program);
+    glDeleteProgram(shader);
+    shader = program;
+    onShaderReload();
+    DEBUG_MSG("shaders reloaded");
 }
 #endif
 
+double R2DEngine::now() const {
+#if USE_OPENGL
+    return glfwGetTime();
+#elif USE_SDL2
+    return (double)SDL_GetPerformanceCounter() / (double)SDL_GetPerformanceFrequency();
+#endif
+}
+
+void R2DEngine::waitForFrame(double frameStart) {
+    // sleep instead of spinning, only the last fraction of a millisecond is polled
+    double remaining = minFrameTime - (now() - frameStart);
+    if (remaining > 0.0005) {
+        std::this_thread::sleep_for(std::chrono::duration<double>(remaining - 0.0005));
+    }
+    while (now() - frameStart < minFrameTime) {
+        std::this_thread::yield();
+    }
+}
+
+bool R2DEngine::runFixedSteps(double deltaTime) {
+    if (fixedStep <= 0.0) {
+        return true;
+    }
+
+    stepAccumulator += deltaTime;
+    int32_t steps = 0;
+    while (stepAccumulator >= fixedStep && steps < maxSubSteps) {
+        if (!onFixedUpdate(fixedStep)) {
+            return false;
+        }
+        stepAccumulator -= fixedStep;
+        steps ++;
+    }
+    if (stepAccumulator >= fixedStep) {
+        // more behind than the budget allows, the game runs slower instead of spiraling
+        droppedSteps += static_cast<int64_t>(stepAccumulator / fixedStep);
+        stepAccumulator = fmod(stepAccumulator, fixedStep);
+    }
+    stepCount += steps;
+
+    rateSteps += steps;
+    double time = now();
+    if (time - rateTime >= 1.0) {
+        stepRate = rateSteps / (time - rateTime);
+        rateSteps = 0;
+        rateTime = time;
+    }
+    return true;
+}
+
+void R2DEngine::pollEvents(double deltaTime) {
+    std::string title = windowTitle + " - FPS: " + std::to_string(1.0 / deltaTime);
+    if (fixedStep > 0.0) {
+        title += " - ticks/s: " + std::to_string(stepRate);
+    }
+#if USE_OPENGL
+    glfwSetWindowTitle(window, title.c_str());
+
+    glfwPollEvents();
+    if (glfwWindowShouldClose(window)) {
+        loop = false;
+        return;
+    }
+    bool overlayKey = getKeyState(GLFW_KEY_F3) == PRESS;
+    if (overlayKey && !overlayKeyHeld) {
+        showProfile = !showProfile;
+    }
+    overlayKeyHeld = overlayKey;
+    glfwGetCursorPos(window, &mousePosX, &mousePosY);
+    mousePosX = round(mousePosX / screenWidth * innerWidth);
+    mousePosY = round(mousePosY / screenHeight * innerHeight);
+    GLint m_viewport[4];
+    glGetIntegerv(GL_VIEWPORT, m_viewport);
+    screenWidth = m_viewport[2];
+    screenHeight = m_viewport[3];
+#elif USE_SDL2
+    SDL_SetWindowTitle(window, title.c_str());
+    while (SDL_PollEvent(&event)) {
+        switch (event.type) {
+            case SDL_QUIT: {
+                loop = false;
+                break;
+            }
+            case SDL_KEYDOWN: {
+                if (event.key.keysym.sym == SDLK_F3 && !event.key.repeat) {
+                    showProfile = !showProfile;
+                }
+                break;
+            }
+            case SDL_MOUSEMOTION: {
+                mousePosX = event.motion.x;
+                mousePosY = event.motion.y;
+                mousePosX = round(mousePosX / screenWidth * innerWidth);
+                mousePosY = round(mousePosY / screenHeight * innerHeight);
+                break;
+            }
+        }
+    }
+    SDL_GetWindowSize(window, &screenWidth, &screenHeight);
+#endif
+}
+
 void R2DEngine::gameLoop() {
     if (!onCreate()) {
         loop = false;
     }
 
     double deltaTime = 0.0;
-#if USE_OPENGL
-    double time_a = glfwGetTime();
-    double time_b = glfwGetTime();
-#elif USE_SDL2
-    uint64_t time_a = SDL_GetPerformanceCounter();
-    uint64_t time_b = SDL_GetPerformanceCounter();
-#endif
+    double time_a = now();
+    double time_b = now();
+    rateTime = time_a;
 
     DEBUG_MSG("game loop start");
     while (loop) {
         while (loop) {
-#if USE_OPENGL
-            time_b = glfwGetTime();
-            deltaTime = time_b - time_a;
-            while (deltaTime < 0.001) {
-                time_b = glfwGetTime();
+            {
+                ProfileZone frame(&profiler, "frame");
+                {
+                    ProfileZone zone(&profiler, "wait");
+                    waitForFrame(time_a);
+                }
+                time_b = now();
                 deltaTime = time_b - time_a;
-            }
-            time_a = time_b;
-            std::string title = windowTitle + " - FPS: " + std::to_string(1.0 / deltaTime);
-            glfwSetWindowTitle(window, title.c_str());
+                time_a = time_b;
+                {
+                    ProfileZone zone(&profiler, "input");
+                    pollEvents(deltaTime);
+                }
+                if (!loop) {
+                    break;
+                }
+#if USE_OPENGL
+                reloadChangedShaders();
+#endif
 
-            glfwPollEvents();
-            if (glfwWindowShouldClose(window)) {
-                loop = false;
-                break;
-            }
-            glfwGetCursorPos(window, &mousePosX, &mousePosY);
-            mousePosX = round(mousePosX / screenWidth * innerWidth);
-            mousePosY = round(mousePosY / screenHeight * innerHeight);
-            GLint m_viewport[4];
-            glGetIntegerv(GL_VIEWPORT, m_viewport);
-            screenWidth = m_viewport[2];
-            screenHeight = m_viewport[3];
-#elif USE_SDL2
-            time_b = SDL_GetPerformanceCounter();
-            deltaTime = (double)((time_b - time_a) / (double)SDL_GetPerformanceFrequency());
-            time_a = time_b;
-            std::string title = windowTitle + " - FPS " + std::to_string(1.0 / deltaTime);
-            SDL_SetWindowTitle(window, title.c_str());
-            while (SDL_PollEvent(&event)) {
-                switch (event.type) {
-                    case SDL_QUIT: {
+                clearBuffer();
+                {
+                    ProfileZone zone(&profiler, "fixed update");
+                    if (!runFixedSteps(deltaTime)) {
                         loop = false;
-                        break;
                     }
-                    case SDL_MOUSEMOTION: {
-                        mousePosX = event.motion.x;
-                        mousePosY = event.motion.y;
-                        mousePosX = round(mousePosX / screenWidth * innerWidth);
-                        mousePosY = round(mousePosY / screenHeight * innerHeight);
-                        break;
+                }
+                {
+                    ProfileZone zone(&profiler, "update");
+                    if (loop && !onUpdate(deltaTime)) {
+                        loop = false;
                     }
                 }
+                swapBuffers();
             }
-            SDL_GetWindowSize(window, &screenWidth, &screenHeight);
-#endif
-            
-            clearBuffer();
-            if (!onUpdate(deltaTime)) {
-                loop = false;
-            }
-            swapBuffers();
+            profiler.endFrame();
         }
 
         if (!onDestroy()) {
@@ -651,6 +1257,9 @@ void R2DEngine::gameLoop() {
     }
 
     DEBUG_MSG("game loop end");
+    if (!profileTracePath.empty() && !profileLog.writeTrace(profileTracePath)) {
+        DEBUG_ERROR("Failed to write the profile trace");
+    }
 
 #if USE_OPENGL
     if (ibo != 0) {
@@ -665,8 +1274,23 @@ void R2DEngine::gameLoop() {
         glDeleteBuffers(1, &vao);
         vao = 0;
     }
+    for (int32_t i = 0; i < uploadSlices; i ++) {
+        if (uploadFences[i]) {
+            glDeleteSync(uploadFences[i]);
+            uploadFences[i] = nullptr;
+        }
+    }
+    if (uploadBuffer != 0) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBuffer);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &uploadBuffer);
+        uploadBuffer = 0;
+        uploadData = nullptr;
+    }
+    glDeleteProgram(shader);
     glDeleteTextures(1, &bufferTexture);
-    delete bufferData;
+    delete[] bufferData;
             
     glfwDestroyWindow(window);
     glfwTerminate();
@@ -674,7 +1298,7 @@ void R2DEngine::gameLoop() {
     DEBUG_MSG("glfw destroyed");
 #elif USE_SDL2
     SDL_DestroyTexture(bufferTexture);
-    delete bufferData;
+    delete[] bufferData;
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     Mix_Quit();
@@ -686,12 +1310,27 @@ void R2DEngine::gameLoop() {
 }
 
 void R2DEngine::drawPoint(Coord coord, Color color) {
-    if (0 <= coord.x && coord.x < innerWidth && 0 <= coord.y && coord.y < innerHeight) {
-        bufferData[coord.y * innerWidth * 4 + coord.x * 4 + 0] = color.r;
-        bufferData[coord.y * innerWidth * 4 + coord.x * 4 + 1] = color.g;
-        bufferData[coord.y * innerWidth * 4 + coord.x * 4 + 2] = color.b;
-        bufferData[coord.y * innerWidth * 4 + coord.x * 4 + 3] = color.a;
-    }
+    canvas.point(coord.x, coord.y, color.pixel());
+}
+
+void R2DEngine::drawLine(Coord coord1, Coord coord2, Color color) {
+    canvas.line(coord1.x, coord1.y, coord2.x, coord2.y, color.pixel());
+}
+
+void R2DEngine::drawSpan(Coord coord, int32_t length, Color color) {
+    canvas.span(coord.x, coord.y, length, color.pixel());
+}
+
+void R2DEngine::fillRect(Rect rect, Color color) {
+    canvas.fillRect(rect.x, rect.y, rect.w, rect.h, color.pixel());
+}
+
+void R2DEngine::blitRow(Coord coord, const uint32_t* pixels, int32_t count) {
+    canvas.blitRow(coord.x, coord.y, pixels, count);
+}
+
+void R2DEngine::blitIndexed(Rect rect, const int32_t* indices, ptrdiff_t stride, const uint32_t* palette, int32_t paletteSize) {
+    canvas.blitIndexed(rect.x, rect.y, rect.w, rect.h, indices, stride, palette, paletteSize);
 }
 
 R2DEngine::InputState R2DEngine::getKeyState(int key) const {
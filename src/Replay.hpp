@@ -0,0 +1,311 @@
+/**
+ * @file Replay.hpp
+ * @brief Recording of brush edits per tick and their deterministic replay
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#ifndef REPLAY_HPP
+#define REPLAY_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Cell.hpp"
+#include "Grid.hpp"
+#include "Simulation.hpp"
+#include "Snapshot.hpp"
+
+/*
+A Recording is the world at the tick the recording began plus every edit
+made after it, stamped with the tick it was applied before. The rules are
+deterministic, so a Replayer that applies the same edits before the same
+ticks reproduces the run cell for cell, and the state hash stored at the
+end of the recording tells whether it did.
+
+The hash only matches for the update mode the run was recorded with: the
+serial sweep and the GPU agree with each other, the banded sweep of
+several threads and the in-place update, serial or banded, each take
+their own path. So does the water model, which the recording keeps with
+the update mode.
+
+A recording file is
+
+ReplayHeader
+eventCount events of 12 bytes: ticks since the previous event (the first
+    one since startTick), x and y as uint16_t, the CellID, one unused
+    byte and the mass in units of Cell
+the starting world as an rle snapshot, up to the end of the file
+*/
+enum class ReplayMode : uint32_t {
+    SERIAL,
+    BANDED,
+    IN_PLACE,
+    IN_PLACE_BANDED
+};
+
+inline const char* replayModeName(ReplayMode mode) {
+    switch (mode) {
+        case ReplayMode::SERIAL: return "serial";
+        case ReplayMode::BANDED: return "banded";
+        case ReplayMode::IN_PLACE: return "in place";
+        case ReplayMode::IN_PLACE_BANDED: return "in place, banded";
+    }
+    return "";
+}
+
+// the update mode sim currently ticks with
+inline ReplayMode replayMode(const Simulation& sim) {
+    if (sim.inPlace()) {
+        return sim.threads() > 1 ? ReplayMode::IN_PLACE_BANDED : ReplayMode::IN_PLACE;
+    }
+    return sim.threads() > 1 ? ReplayMode::BANDED : ReplayMode::SERIAL;
+}
+
+struct ReplayHeader {
+    char magic[8];
+    uint32_t version;
+    // offset of the first event
+    uint32_t headerSize;
+    uint32_t eventSize;
+    uint32_t mode;
+    uint64_t eventCount;
+    uint64_t startTick;
+    uint64_t endTick;
+    uint64_t endHash;
+    // Simulation::WaterModel, 0 in recordings older than the water models
+    uint32_t waterModel;
+    uint8_t reserved[4];
+};
+
+static_assert(sizeof(ReplayHeader) == 64, "the replay header is 64 bytes");
+
+struct ReplayEvent {
+    // applied before this tick
+    uint64_t tick;
+    int32_t x;
+    int32_t y;
+    Simulation::CellID id;
+    uint16_t mass;
+};
+
+namespace ReplayDetail {
+    constexpr char magic[8] = {'S', 'A', 'N', 'D', 'R', 'E', 'P', 'L'};
+    constexpr uint32_t version = 1;
+    constexpr uint32_t eventSize = 12;
+};
+
+class Recording {
+private:
+    Grid<Cell> start;
+    uint64_t startTick;
+    ReplayMode updateMode;
+    Simulation::WaterModel water;
+    std::vector<ReplayEvent> log;
+    uint64_t finalTick;
+    uint64_t finalHash;
+
+public:
+    Recording() : startTick(0), updateMode(ReplayMode::SERIAL), water(Simulation::WaterModel::MASS), finalTick(0), finalHash(0) {}
+
+    // start over from a copy of the world as it is before tick
+    void begin(const Grid<Cell>& cells, uint64_t tick, ReplayMode mode, Simulation::WaterModel model = Simulation::WaterModel::MASS) {
+        start = cells;
+        startTick = tick;
+        updateMode = mode;
+        water = model;
+        log.clear();
+        finalTick = tick;
+        finalHash = 0;
+    }
+
+    bool recording() const {
+        return start.width() > 0;
+    }
+
+    // an edit applied before tick, edits outside the world are dropped as the simulation drops them
+    void record(uint64_t tick, int32_t x, int32_t y, Simulation::CellID id, float mass) {
+        if (!start.contains(x, y)) {
+            return;
+        }
+        ReplayEvent event;
+        event.tick = tick;
+        event.x = x;
+        event.y = y;
+        event.id = id;
+        event.mass = Cell::toUnits(mass);
+        log.push_back(event);
+    }
+
+    // the tick the run stopped before and the state hash of the world at that point
+    void finish(uint64_t tick, uint64_t hash) {
+        finalTick = tick;
+        finalHash = hash;
+    }
+
+    const std::vector<ReplayEvent>& events() const {
+        return log;
+    }
+
+    uint64_t firstTick() const {
+        return startTick;
+    }
+
+    uint64_t endTick() const {
+        return finalTick;
+    }
+
+    uint64_t endHash() const {
+        return finalHash;
+    }
+
+    ReplayMode mode() const {
+        return updateMode;
+    }
+
+    Simulation::WaterModel waterModel() const {
+        return water;
+    }
+
+    // false if the file can not be written or the world is too large for the event coordinates
+    bool save(const std::string& path) const {
+        using namespace ReplayDetail;
+        if (!recording() || start.width() > 0xffff || start.height() > 0xffff) {
+            return false;
+        }
+        ReplayHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, magic, sizeof(header.magic));
+        header.version = version;
+        header.headerSize = sizeof(ReplayHeader);
+        header.eventSize = eventSize;
+        header.mode = static_cast<uint32_t>(updateMode);
+        header.waterModel = static_cast<uint32_t>(water);
+        header.eventCount = log.size();
+        header.startTick = startTick;
+        header.endTick = finalTick;
+        header.endHash = finalHash;
+
+        std::vector<uint8_t> events(log.size() * eventSize);
+        uint64_t previous = startTick;
+        for (size_t i = 0; i < log.size(); i ++) {
+            const ReplayEvent& event = log[i];
+            uint8_t* record = &events[i * eventSize];
+            uint32_t delta = static_cast<uint32_t>(event.tick - previous);
+            uint16_t x = static_cast<uint16_t>(event.x);
+            uint16_t y = static_cast<uint16_t>(event.y);
+            memcpy(record, &delta, 4);
+            memcpy(record + 4, &x, 2);
+            memcpy(record + 6, &y, 2);
+            record[8] = static_cast<uint8_t>(event.id);
+            record[9] = 0;
+            memcpy(record + 10, &event.mass, 2);
+            previous = event.tick;
+        }
+
+        FILE* file = fopen(path.c_str(), "wb");
+        if (!file) {
+            return false;
+        }
+        bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+        written = written && fwrite(events.data(), 1, events.size(), file) == events.size();
+        written = written && writeSnapshot(file, start, startTick, SnapshotCompression::RLE);
+        return fclose(file) == 0 && written;
+    }
+
+    // read a recording and put its starting world into world, false if the file is not a recording
+    bool load(const std::string& path, Simulation& world) {
+        using namespace ReplayDetail;
+        SnapshotDetail::MappedFile file;
+        if (!file.open(path) || file.size() < sizeof(ReplayHeader)) {
+            return false;
+        }
+        ReplayHeader header;
+        memcpy(&header, file.data(), sizeof(header));
+        if (memcmp(header.magic, magic, sizeof(header.magic)) != 0 || header.version != version ||
+            header.headerSize < sizeof(ReplayHeader) || header.eventSize != eventSize ||
+            header.mode > static_cast<uint32_t>(ReplayMode::IN_PLACE_BANDED) ||
+            header.waterModel > static_cast<uint32_t>(Simulation::WaterModel::PRESSURE) ||
+            header.headerSize > file.size() || header.eventCount > (file.size() - header.headerSize) / eventSize) {
+            return false;
+        }
+
+        const uint8_t* events = file.data() + header.headerSize;
+        size_t eventBytes = header.eventCount * eventSize;
+        Simulation loaded;
+        if (!readSnapshot(events + eventBytes, file.size() - header.headerSize - eventBytes, loaded) ||
+            loaded.tickCount() != header.startTick) {
+            return false;
+        }
+
+        std::vector<ReplayEvent> decoded(header.eventCount);
+        uint64_t tick = header.startTick;
+        for (size_t i = 0; i < decoded.size(); i ++) {
+            const uint8_t* record = events + i * eventSize;
+            uint32_t delta;
+            uint16_t x;
+            uint16_t y;
+            memcpy(&delta, record, 4);
+            memcpy(&x, record + 4, 2);
+            memcpy(&y, record + 6, 2);
+            tick += delta;
+            decoded[i].tick = tick;
+            decoded[i].x = x;
+            decoded[i].y = y;
+            decoded[i].id = static_cast<Simulation::CellID>(record[8]);
+            memcpy(&decoded[i].mass, record + 10, 2);
+        }
+
+        start = loaded.cells();
+        startTick = header.startTick;
+        updateMode = static_cast<ReplayMode>(header.mode);
+        water = static_cast<Simulation::WaterModel>(header.waterModel);
+        log.swap(decoded);
+        finalTick = header.endTick;
+        finalHash = header.endHash;
+        world = std::move(loaded);
+        return true;
+    }
+};
+
+/*
+Replayer walks the events of a Recording in order. Before every tick the
+owner calls apply() with the tick about to run, and every event stamped
+with that tick is set in the world, which can be a Simulation or a
+GpuSimulation.
+*/
+class Replayer {
+private:
+    const Recording* recording;
+    size_t next;
+
+public:
+    explicit Replayer(const Recording* recording = nullptr) : recording(recording), next(0) {}
+
+    template <typename World>
+    void apply(World& world, uint64_t tick) {
+        if (!recording) {
+            return;
+        }
+        const std::vector<ReplayEvent>& events = recording->events();
+        while (next < events.size() && events[next].tick <= tick) {
+            const ReplayEvent& event = events[next];
+            world.set(event.x, event.y, event.id, Cell::toMass(event.mass));
+            next ++;
+        }
+    }
+
+    // true once every tick of the recording ran
+    bool finished(uint64_t tick) const {
+        return !recording || tick >= recording->endTick();
+    }
+};
+
+#endif
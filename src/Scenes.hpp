@@ -0,0 +1,172 @@
+/**
+ * @file Scenes.hpp
+ * @brief Seeded and image based starting worlds for the simulation
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#ifndef SCENES_HPP
+#define SCENES_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "Simulation.hpp"
+
+/*
+EMPTY   walls around the border
+SAND    a thick sand pile dropped from the upper half
+WATER   a tank filled with water up to a quarter of the height
+MIXED   random sand above a water tank with a few wall ledges
+MATERIALS   random sand, gravel and sawdust above a water tank with stone
+        ledges, every powder sinks through the lighter ones
+*/
+enum class Scene {
+    EMPTY,
+    SAND,
+    WATER,
+    MIXED,
+    MATERIALS
+};
+
+inline const char* sceneName(Scene scene) {
+    switch (scene) {
+        case Scene::EMPTY: return "empty";
+        case Scene::SAND: return "sand";
+        case Scene::WATER: return "water";
+        case Scene::MIXED: return "mixed";
+        case Scene::MATERIALS: return "materials";
+    }
+    return "";
+}
+
+inline bool parseScene(const char* name, Scene& scene) {
+    for (Scene s : {Scene::EMPTY, Scene::SAND, Scene::WATER, Scene::MIXED, Scene::MATERIALS}) {
+        if (strcmp(name, sceneName(s)) == 0) {
+            scene = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void seedScene(Simulation& sim, Scene scene, uint32_t seed) {
+    int32_t w = sim.width();
+    int32_t h = sim.height();
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> dist(0.0, 1.0);
+
+    for (int32_t y = 0; y < h; y ++) {
+        for (int32_t x = 0; x < w; x ++) {
+            if (y == 0 || y == h - 1 || x == 0 || x == w - 1) {
+                sim.set(x, y, Simulation::WALL);
+                continue;
+            }
+            switch (scene) {
+                case Scene::EMPTY: {
+                    break;
+                }
+                case Scene::SAND: {
+                    if (y < h / 2 && x > w / 4 && x < w * 3 / 4 && dist(rng) < 0.6) {
+                        sim.set(x, y, Simulation::SAND);
+                    }
+                    break;
+                }
+                case Scene::WATER: {
+                    if (y > h * 3 / 4) {
+                        sim.set(x, y, Simulation::WATER, Simulation::maxMass);
+                    }
+                    break;
+                }
+                case Scene::MIXED: {
+                    if (y < h / 2) {
+                        if (dist(rng) < 0.3) {
+                            sim.set(x, y, Simulation::SAND);
+                        }
+                    } else if (y > h * 3 / 4) {
+                        sim.set(x, y, Simulation::WATER, Simulation::maxMass);
+                    } else if (y == h * 5 / 8 && (x / 16) % 3 == 0) {
+                        sim.set(x, y, Simulation::WALL);
+                    }
+                    break;
+                }
+                case Scene::MATERIALS: {
+                    if (y < h / 2) {
+                        float r = dist(rng);
+                        if (r < 0.1) {
+                            sim.set(x, y, Materials::SAND);
+                        } else if (r < 0.2) {
+                            sim.set(x, y, Materials::GRAVEL);
+                        } else if (r < 0.3) {
+                            sim.set(x, y, Materials::SAWDUST);
+                        }
+                    } else if (y > h * 3 / 4) {
+                        sim.set(x, y, Simulation::WATER, Simulation::maxMass);
+                    } else if (y == h * 5 / 8 && (x / 16) % 3 == 0) {
+                        sim.set(x, y, Materials::STONE);
+                    }
+                    break;
+                }
+            }
+        }
+    }
+}
+
+/*
+Load a world from a binary PPM (P6) image. Every pixel becomes the material
+whose draw color in Materials.hpp is closest, e.g. wall (200, 200, 200),
+sand (200, 200, 50), water (0, 255, 255); anything close to black is air.
+*/
+inline bool loadScenePPM(const std::string& path, Simulation& sim) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    char magic[3] = {0};
+    int width = 0;
+    int height = 0;
+    int maxValue = 0;
+    if (fscanf(file, "%2s %d %d %d", magic, &width, &height, &maxValue) != 4 ||
+        strcmp(magic, "P6") != 0 || width <= 0 || height <= 0 || maxValue != 255) {
+        fclose(file);
+        return false;
+    }
+    fgetc(file);
+
+
+    sim = Simulation(width, height);
+    std::string row(static_cast<size_t>(width) * 3, '\0');
+    for (int y = 0; y < height; y ++) {
+        if (fread(&row[0], 1, row.size(), file) != row.size()) {
+            fclose(file);
+            return false;
+        }
+        for (int x = 0; x < width; x ++) {
+            int r = static_cast<uint8_t>(row[x * 3 + 0]);
+            int g = static_cast<uint8_t>(row[x * 3 + 1]);
+            int b = static_cast<uint8_t>(row[x * 3 + 2]);
+            Simulation::CellID best = Simulation::AIR;
+            int bestDistance = 1 << 30;
+            for (int32_t id = 0; id < Materials::COUNT; id ++) {
+                const Materials::Material& swatch = Materials::table[id];
+                int distance = (r - swatch.r) * (r - swatch.r) + (g - swatch.g) * (g - swatch.g) + (b - swatch.b) * (b - swatch.b);
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    best = static_cast<Simulation::CellID>(id);
+                }
+            }
+            sim.set(x, y, best, best == Simulation::WATER ? Simulation::maxMass : 0.0f);
+        }
+    }
+    fclose(file);
+    return true;
+}
+
+#endif
@@ -0,0 +1,1392 @@
+/**
+ * @file Simulation.hpp
+ * @brief Sand and water cell simulation, independent of any graphics context
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#ifndef SIMULATION_HPP
+#define SIMULATION_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "Cell.hpp"
+#include "Grid.hpp"
+#include "Materials.hpp"
+#include "Profiler.hpp"
+#include "ThreadPool.hpp"
+#include "WaterKernel.hpp"
+
+/*
+Simulation owns the cell grids and advances them one tick at a time.
+
+The world is split into chunks of chunkSize x chunkSize cells. A chunk is
+only reset, swept and committed while it is awake. Whenever a rule moves
+material it marks the cells it changed; at the end of the tick every chunk
+with changes, and every neighbor whose border they touch, stays awake for
+the next tick. Everything else falls asleep and costs nothing until a move
+or an edit next to it wakes it up again. Between ticks mapBuffer always
+equals map, so sleeping chunks need no copies.
+
+Sleeping chunks are not even looked at: edits and changes put the chunks
+they wake on a worklist, each chunk once. A tick sorts it into the chunks
+it runs, adds the sleeping chunks next to them, which material can move
+into, and the passes walk that list a chunk row at a time, bottom up for
+the sweep. The bookkeeping of a tick scales with the chunks it runs, not
+with the size of the world, and the chunks are the ones a full scan of
+the world would have run, in the same order.
+
+Both grids hold packed Cells (see Cell.hpp): type, flags and a 16-bit
+fixed-point mass in one word, 8 bytes per cell for the whole simulation.
+Sand swaps only the type of two cells, water moves whole mass units, so
+mass is conserved exactly unless a cell saturates.
+
+With more than one thread the sweep runs on bands of one chunk row. A cell
+only reads and writes the rows directly above and below it, so bands two
+apart never touch the same row: all even bands are swept in parallel, then
+all odd bands. The band layout only depends on the world size, so every
+thread count above one produces the same world.
+
+Unless the water kernel is Water::SCALAR, a row is swept in two passes:
+first its sand and walls, then all of its water at once with the vector
+kernels of WaterKernel.hpp. The water pass sees the row exactly as the
+serial sweep would, see sweepChunkRowVector().
+
+The rules do not name materials, they dispatch on the update rule of a
+cell's type in Materials.hpp and compare densities from the same table:
+a powder sinks into anything lighter that is not static, and whatever it
+displaced takes its old place.
+
+tick() can color the world as it commits it: given a ColorTarget, the
+commit pass colors the rows and columns of a chunk that changed during
+the tick right after copying the chunk back into map, while its cells are
+still in cache, on the same threads and bands as the commit. Pixels that
+showed the world as it was before the tick then show it after, without a
+second pass over the world.
+
+setInPlace(true) switches to a single-buffer update: there is no
+mapBuffer, the rules move whole cells and mass directly in map, and no
+reset or commit pass runs. Powders swap with what they fall into, water
+flows with the masses as the sweep has left them so far. The UPDATED
+flag of a cell holds the parity of the last tick that moved it, a cell
+whose flag equals the parity of the current tick was moved there during
+this tick and is not moved again. Rows alternate their scan direction
+every tick, and the rules are mirrored with it, so neither side is
+favored. This mode runs the scalar rules only and does not produce the
+same worlds as the double-buffered update.
+
+The mass model of water needs hundreds of ticks to level a large body,
+and a body that holds still keeps trading mass between its cells.
+setWaterModel(WaterModel::PRESSURE) levels bodies directly instead. The
+local rule only runs on water at a free surface, a water cell next to
+air, so the inside of a body holds still. After the sweep a flood fill
+from the water of the awake chunks collects every connected body it
+reaches, with its surface cells, the water with air above, and the air
+next to it that rests on something. The highest surface cell then moves
+into the lowest of those open cells, again and again, while the open
+cell is lower, so a body ends up level in the tick it got uneven. Mass
+moves whole cells at a time and stays exact. A body that is level and
+holds still falls asleep with its chunks and costs nothing. The GPU
+backend only has the mass model.
+*/
+class Simulation {
+public:
+    // a Materials::ID, the rules only name the ones the water model and the halo are built on
+    typedef Materials::ID CellID;
+    static constexpr CellID AIR = Materials::AIR;
+    static constexpr CellID WALL = Materials::WALL;
+    static constexpr CellID SAND = Materials::SAND;
+    static constexpr CellID WATER = Materials::WATER;
+
+    // water
+    static constexpr float maxMass = Water::maxMass;
+    static constexpr float maxCompress = Water::maxCompress;
+    static constexpr float minMass = Water::minMass;
+    static constexpr float minFlow = Water::minFlow;
+    static constexpr float maxSpeed = Water::maxSpeed;
+
+    // flows up to this much move mass but do not keep a chunk awake
+    static constexpr float sleepFlow = 0.0005;
+
+    // chunk edge in cells, also the rows per band of the parallel sweep
+    static constexpr int32_t chunkShift = 5;
+    static constexpr int32_t chunkSize = 1 << chunkShift;
+
+    struct Rect {
+        int32_t x = 0;
+        int32_t y = 0;
+        int32_t w = 0;
+        int32_t h = 0;
+        Rect(int32_t x = 0, int32_t y = 0, int32_t w = 0, int32_t h = 0) : x(x), y(y), w(w), h(h) {}
+    };
+
+    enum class WaterModel : uint8_t {
+        // every water cell flows by the local rule
+        MASS,
+        // the local rule at free surfaces, bodies leveled as a whole, see above
+        PRESSURE
+    };
+
+    // where tick() colors the cells it commits
+    struct ColorTarget {
+        // cell (x, y) at pixels[y * stride + x]
+        uint32_t* pixels = nullptr;
+        ptrdiff_t stride = 0;
+        // color of every type below paletteSize as Canvas::rgba(), other types are transparent
+        const uint32_t* palette = nullptr;
+        int32_t paletteSize = 0;
+    };
+
+private:
+    // bench/sim_benchmark.cpp times the rules one at a time
+    friend struct RuleBenchmark;
+
+    static constexpr int32_t chunkMask = chunkSize - 1;
+
+    struct Chunk {
+        // skipped by the current tick
+        bool sleeping = false;
+        // processed by the next tick
+        bool wake = true;
+        // another chunk moved material into this one during the current tick
+        std::atomic<uint8_t> touched{0};
+        // bit i is set when row / column i of the chunk changed during the current tick
+        std::atomic<uint32_t> changedRows{0};
+        std::atomic<uint32_t> changedCols{0};
+        // changes not collected by takeDirtyRects() yet
+        uint32_t dirtyRows = ~0u;
+        uint32_t dirtyCols = ~0u;
+        // on scheduled during the current tick
+        bool scheduled = false;
+    };
+
+    // the chunks of chunk row cy are scheduled[begin, end)
+    struct ChunkRow {
+        int32_t cy;
+        int32_t begin;
+        int32_t end;
+    };
+
+    int32_t w;
+    int32_t h;
+    uint64_t ticks;
+    std::unique_ptr<ThreadPool> pool;
+    // of the running tick, nullptr when it does not color
+    const ColorTarget* color;
+
+    int32_t cw;
+    int32_t ch;
+    std::vector<Chunk> chunks;
+    // chunks awake during the last tick
+    std::vector<int32_t> awake;
+    // chunks awake during the current tick and the sleeping chunks next to them, by index,
+    // so a chunk row is a run left to right
+    std::vector<int32_t> scheduled;
+    // the chunk rows of scheduled, top down, and the ones of one parity for the banded sweep
+    std::vector<ChunkRow> scheduledRows;
+    std::vector<ChunkRow> bands;
+    // chunks woken for the next tick, each once
+    std::vector<int32_t> waking;
+    // chunks with dirty rows, each once
+    std::vector<int32_t> dirtyChunks;
+    int32_t active;
+    bool sleepEnabled;
+    bool inPlaceEnabled;
+    // UPDATED or 0, the parity of the current tick in place
+    uint8_t parity;
+    WaterModel model;
+    // PRESSURE: cells the body search of tick bodyStamp has seen, and its worklists
+    std::vector<uint32_t> bodyVisits;
+    uint32_t bodyStamp;
+    std::vector<int32_t> bodyStack;
+    std::vector<int32_t> bodySurface;
+    std::vector<int32_t> bodyOpen;
+    // times the phases of tick(), not owned
+    Profiler* profiler;
+
+    Water::Kernel kernel;
+
+    Grid<Cell> map;
+    Grid<Cell> mapBuffer;
+
+    void update_static(int x, int y) {
+        mapBuffer[y][x].type = map[y][x].type;
+    }
+
+    Chunk& chunkAt(int32_t x, int32_t y) {
+        return chunks[chunkIndex(x, y)];
+    }
+
+    int32_t chunkIndex(int32_t x, int32_t y) const {
+        return (y >> chunkShift) * cw + (x >> chunkShift);
+    }
+
+    // process chunk i during the next tick
+    void wakeIndex(int32_t i) {
+        if (!chunks[i].wake) {
+            chunks[i].wake = true;
+            waking.push_back(i);
+        }
+    }
+
+    // redraw rows and cols of chunk i
+    void markDirty(int32_t i, uint32_t rows, uint32_t cols) {
+        Chunk& chunk = chunks[i];
+        if (!chunk.dirtyRows && rows) {
+            dirtyChunks.push_back(i);
+        }
+        chunk.dirtyRows |= rows;
+        chunk.dirtyCols |= cols;
+    }
+
+    // an edit between the passes of a tick, redrawn and woken with its neighbors for the next tick
+    void edited(int32_t x, int32_t y) {
+        markDirty(chunkIndex(x, y), 1u << (y & chunkMask), 1u << (x & chunkMask));
+        for (int32_t dy = -1; dy <= 1; dy ++) {
+            for (int32_t dx = -1; dx <= 1; dx ++) {
+                if (map.contains(x + dx, y + dy)) {
+                    wakeIndex(chunkIndex(x + dx, y + dy));
+                }
+            }
+        }
+    }
+
+    void markChanged(int32_t x, int32_t y) {
+        Chunk& chunk = chunkAt(x, y);
+        uint32_t row = 1u << (y & chunkMask);
+        uint32_t col = 1u << (x & chunkMask);
+        if (!(chunk.changedRows.load(std::memory_order_relaxed) & row)) {
+            chunk.changedRows.fetch_or(row, std::memory_order_relaxed);
+        }
+        if (!(chunk.changedCols.load(std::memory_order_relaxed) & col)) {
+            chunk.changedCols.fetch_or(col, std::memory_order_relaxed);
+        }
+    }
+
+    void markTouched(int32_t x, int32_t y, int32_t nx, int32_t ny) {
+        if ((x >> chunkShift) != (nx >> chunkShift) || (y >> chunkShift) != (ny >> chunkShift)) {
+            chunkAt(nx, ny).touched.store(1, std::memory_order_relaxed);
+        }
+    }
+
+    // material moved from (x, y) to (nx, ny)
+    void moved(int32_t x, int32_t y, int32_t nx, int32_t ny) {
+        markTouched(x, y, nx, ny);
+        markChanged(x, y);
+        markChanged(nx, ny);
+    }
+
+    // flow mass units went from (x, y) to (nx, ny)
+    void flowed(int32_t x, int32_t y, int32_t nx, int32_t ny, int32_t flow) {
+        if (flow <= 0) return;
+        markTouched(x, y, nx, ny);
+        if (Cell::toMass(flow) > sleepFlow) {
+            markChanged(x, y);
+            markChanged(nx, ny);
+        }
+    }
+
+    // a powder swaps types with what it falls into, the masses stay where they are;
+    // air and water come back from the masses at commit, anything else is put back here
+    void update_powder(int x, int y) {
+        uint8_t id = map[y][x].type;
+        uint8_t density = Materials::lookup.density[id];
+        for (int nx : {x, x - 1, x + 1}) {
+            uint8_t target = map[y + 1][nx].type;
+            if (Materials::lookup.yield[target] < density) {
+                mapBuffer[y + 1][nx].type = id;
+                map[y][x].type = target;
+                if (!Materials::lookup.fluid[target]) {
+                    mapBuffer[y][x].type = target;
+                }
+                moved(x, y, nx, y + 1);
+                return;
+            }
+        }
+        mapBuffer[y][x].type = id;
+    }
+
+    inline float constrain(float x, float min, float max) {
+        return Water::constrain(x, min, max);
+    }
+
+    bool open(int32_t x, int32_t y) const {
+        return Materials::lookup.fluid[map[y][x].type];
+    }
+
+    // water next to air, the only water the local rule moves under WaterModel::PRESSURE
+    bool freeSurface(int32_t x, int32_t y) const {
+        return map[y - 1][x].type == AIR || map[y + 1][x].type == AIR || map[y][x - 1].type == AIR || map[y][x + 1].type == AIR;
+    }
+
+    // the flows of the water in [x0, x1) of a row that is not at a free surface, as freeSurface() sees the row in the serial sweep
+    void holdEnclosed(const Water::Row& water, int32_t x0, int32_t x1) {
+        for (int32_t x = x0; x < x1; x ++) {
+            if (water.cells[x].type == WATER && water.above[x].type != AIR && water.below[x].type != AIR &&
+                water.swept[x - 1].type != AIR && water.cells[x + 1].type != AIR) {
+                water.down[x] = 0;
+                water.right[x] = 0;
+                water.left[x] = 0;
+                water.up[x] = 0;
+            }
+        }
+    }
+
+    // air that water moved into stays put, it rests on something
+    bool restingOpen(int32_t x, int32_t y) const {
+        return map[y][x].type == AIR && map[y + 1][x].type != AIR;
+    }
+
+    void levelBody(int32_t x, int32_t y);
+    void levelWaterBodies();
+
+    // move flow mass units from (x, y) to (nx, ny)
+    void moveMass(int32_t x, int32_t y, int32_t nx, int32_t ny, int32_t flow) {
+        mapBuffer[y][x].mass = Cell::subUnits(mapBuffer[y][x].mass, flow);
+        mapBuffer[ny][nx].mass = Cell::addUnits(mapBuffer[ny][nx].mass, flow);
+        flowed(x, y, nx, ny, flow);
+    }
+
+    // flows are worked out in float and moved in whole units, see WaterKernel.hpp
+    void update_water(int x, int y) {
+        float flow = 0.0;
+        int32_t units = 0;
+        float cellMass = map[y][x].massValue();
+        float remainingMass = cellMass;
+        if (remainingMass <= 0.0) return;
+
+        // below
+        if (open(x, y + 1)) {
+            float massBelow = map[y + 1][x].massValue();
+            flow = calcFlow(remainingMass + massBelow) - massBelow;
+            if (flow > minFlow) {
+                flow *= 0.5;
+            }
+            units = Cell::flowUnits(constrain(flow, 0, std::min(maxSpeed, remainingMass)));
+            moveMass(x, y, x, y + 1, units);
+            remainingMass -= Cell::toMass(units);
+        }
+
+        if (remainingMass <= 0.0) return;
+
+        // right
+        if (open(x + 1, y)) {
+            flow = (cellMass - map[y][x + 1].massValue()) / 4.0;
+            if (flow > minFlow) {
+                flow *= 0.5;
+            }
+            units = Cell::flowUnits(constrain(flow, 0, remainingMass));
+            moveMass(x, y, x + 1, y, units);
+            remainingMass -= Cell::toMass(units);
+        }
+
+        if (remainingMass <= 0.0) return;
+
+        // left
+        if (open(x - 1, y)) {
+            flow = (cellMass - map[y][x - 1].massValue()) / 4.0;
+            if (flow > minFlow) {
+                flow *= 0.5;
+            }
+            units = Cell::flowUnits(constrain(flow, 0, remainingMass));
+            moveMass(x, y, x - 1, y, units);
+            remainingMass -= Cell::toMass(units);
+        }
+
+        if (remainingMass <= 0.0) return;
+
+        // up
+        if (open(x, y - 1)) {
+            flow = remainingMass - calcFlow(remainingMass + map[y - 1][x].massValue());
+            if (flow > minFlow) {
+                flow *= 0.5;
+            }
+            units = Cell::flowUnits(constrain(flow, 0, std::min(maxSpeed, remainingMass)));
+            moveMass(x, y, x, y - 1, units);
+        }
+    }
+
+    void markMoved(Cell& cell) {
+        cell.flags = static_cast<uint8_t>((cell.flags & ~Cell::UPDATED) | parity);
+    }
+
+    // in place, dir is the scan direction of the row, 1 or -1
+    void update_powder_in_place(int x, int y, int dir) {
+        uint8_t density = Materials::lookup.density[map[y][x].type];
+        for (int nx : {x, x - dir, x + dir}) {
+            Cell& below = map[y + 1][nx];
+            if (Materials::lookup.yield[below.type] < density) {
+                std::swap(map[y][x], below);
+                markMoved(map[y][x]);
+                markMoved(below);
+                moved(x, y, nx, y + 1);
+                return;
+            }
+        }
+    }
+
+    // in place: move flow mass units from (x, y) to (nx, ny), air that fills up becomes water
+    void moveMassInPlace(int32_t x, int32_t y, int32_t nx, int32_t ny, int32_t flow) {
+        if (flow <= 0) return;
+        map[y][x].mass = Cell::subUnits(map[y][x].mass, flow);
+        Cell& target = map[ny][nx];
+        target.mass = Cell::addUnits(target.mass, flow);
+        if (target.type == AIR && target.mass > Water::minUnits) {
+            target.type = WATER;
+            markMoved(target);
+            markChanged(nx, ny);
+        }
+        flowed(x, y, nx, ny, flow);
+    }
+
+    void update_water_in_place(int x, int y, int dir) {
+        int32_t units = 0;
+        float flow = 0.0;
+        float cellMass = map[y][x].massValue();
+        float remainingMass = cellMass;
+
+        // below
+        if (remainingMass > 0.0 && open(x, y + 1)) {
+            float massBelow = map[y + 1][x].massValue();
+            flow = calcFlow(remainingMass + massBelow) - massBelow;
+            if (flow > minFlow) {
+                flow *= 0.5;
+            }
+            units = Cell::flowUnits(constrain(flow, 0, std::min(maxSpeed, remainingMass)));
+            moveMassInPlace(x, y, x, y + 1, units);
+            remainingMass -= Cell::toMass(units);
+        }
+
+        // ahead in the scan direction, then behind
+        for (int nx : {x + dir, x - dir}) {
+            if (remainingMass > 0.0 && open(nx, y)) {
+                flow = (cellMass - map[y][nx].massValue()) / 4.0;
+                if (flow > minFlow) {
+                    flow *= 0.5;
+                }
+                units = Cell::flowUnits(constrain(flow, 0, remainingMass));
+                moveMassInPlace(x, y, nx, y, units);
+                remainingMass -= Cell::toMass(units);
+            }
+        }
+
+        // up
+        if (remainingMass > 0.0 && open(x, y - 1)) {
+            flow = remainingMass - calcFlow(remainingMass + map[y - 1][x].massValue());
+            if (flow > minFlow) {
+                flow *= 0.5;
+            }
+            units = Cell::flowUnits(constrain(flow, 0, std::min(maxSpeed, remainingMass)));
+            moveMassInPlace(x, y, x, y - 1, units);
+        }
+
+        if (map[y][x].mass <= Water::minUnits) {
+            map[y][x].type = AIR;
+            markChanged(x, y);
+        }
+    }
+
+    void updateInPlace(int x, int y, int dir) {
+        Cell& cell = map[y][x];
+        Materials::Rule rule = Materials::lookup.rule[cell.type];
+        if (rule != Materials::Rule::POWDER && rule != Materials::Rule::WATER) return;
+        if ((cell.flags & Cell::UPDATED) == parity) return;
+        if (rule == Materials::Rule::WATER && model == WaterModel::PRESSURE && !freeSurface(x, y)) return;
+        markMoved(cell);
+        if (rule == Materials::Rule::POWDER) {
+            update_powder_in_place(x, y, dir);
+        } else {
+            update_water_in_place(x, y, dir);
+        }
+    }
+
+    // flag every cell of a chunk as not moved during the current tick
+    void resetParity(int32_t cx, int32_t cy) {
+        int32_t x0 = cx * chunkSize;
+        int32_t x1 = std::min(w, x0 + chunkSize);
+        int32_t y1 = std::min(h, (cy + 1) * chunkSize);
+        uint8_t stale = parity ^ Cell::UPDATED;
+        for (int32_t y = cy * chunkSize; y < y1; y ++) {
+            Cell* row = map[y];
+            for (int32_t x = x0; x < x1; x ++) {
+                row[x].flags = static_cast<uint8_t>((row[x].flags & ~Cell::UPDATED) | stale);
+            }
+        }
+    }
+
+    void resetChunk(int32_t cx, int32_t cy) {
+        int32_t x0 = cx * chunkSize;
+        int32_t x1 = std::min(w, x0 + chunkSize);
+        int32_t y1 = std::min(h, (cy + 1) * chunkSize);
+        for (int32_t y = cy * chunkSize; y < y1; y ++) {
+            Cell* row = mapBuffer[y];
+            for (int32_t x = x0; x < x1; x ++) {
+                row[x].type = AIR;
+            }
+        }
+    }
+
+    // sweep the awake chunks of a chunk row from the bottom up
+    void sweepChunkRowScalar(const ChunkRow& chunkRow) {
+        int32_t y0 = chunkRow.cy * chunkSize;
+        int32_t y1 = std::min(h, y0 + chunkSize);
+        for (int y = y1 - 1; y >= y0; y --) {
+            const Cell* row = map[y];
+            for (int32_t i = chunkRow.begin; i < chunkRow.end; i ++) {
+                if (chunks[scheduled[i]].sleeping) continue;
+                int32_t cx = scheduled[i] - chunkRow.cy * cw;
+                int x1 = std::min(w, (cx + 1) * chunkSize);
+                for (int x = cx * chunkSize; x < x1; x ++) {
+                    switch (Materials::lookup.rule[row[x].type]) {
+                        case Materials::Rule::NONE: {
+                            break;
+                        }
+                        case Materials::Rule::STATIC: {
+                            update_static(x, y);
+                            break;
+                        }
+                        case Materials::Rule::POWDER: {
+                            update_powder(x, y);
+                            break;
+                        }
+                        case Materials::Rule::WATER: {
+                            if (model == WaterModel::MASS || freeSurface(x, y)) {
+                                update_water(x, y);
+                            }
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /*
+    Same result as sweepChunkRowScalar(), but the water of each row runs through
+    the vector kernels. In the serial sweep a water cell sees its left
+    neighbor after and its right neighbor before that neighbor moved, so
+    the powders of the row are moved first and the water reads its right
+    neighbors from a copy of the row taken before.
+    */
+    void sweepChunkRowVector(const ChunkRow& chunkRow) {
+        struct Scratch {
+            std::vector<Cell> cells;
+            std::vector<int32_t> down;
+            std::vector<int32_t> right;
+            std::vector<int32_t> left;
+            std::vector<int32_t> up;
+        };
+        thread_local Scratch scratch;
+        size_t size = static_cast<size_t>(w) + 2;
+        if (scratch.cells.size() < size) {
+            scratch.cells.resize(size);
+            scratch.down.resize(size);
+            scratch.right.resize(size);
+            scratch.left.resize(size);
+            scratch.up.resize(size);
+        }
+
+        int32_t y0 = chunkRow.cy * chunkSize;
+        int32_t y1 = std::min(h, y0 + chunkSize);
+        for (int y = y1 - 1; y >= y0; y --) {
+            memcpy(scratch.cells.data(), map[y] - 1, size * sizeof(Cell));
+
+            const Cell* row = map[y];
+            // water sits in [waterBegin, waterEnd), the kernels only run there
+            int32_t waterBegin = w;
+            int32_t waterEnd = 0;
+            for (int32_t i = chunkRow.begin; i < chunkRow.end; i ++) {
+                if (chunks[scheduled[i]].sleeping) continue;
+                int32_t cx = scheduled[i] - chunkRow.cy * cw;
+                int x1 = std::min(w, (cx + 1) * chunkSize);
+                for (int x = cx * chunkSize; x < x1; x ++) {
+                    switch (Materials::lookup.rule[row[x].type]) {
+                        case Materials::Rule::NONE: {
+                            break;
+                        }
+                        case Materials::Rule::STATIC: {
+                            update_static(x, y);
+                            break;
+                        }
+                        case Materials::Rule::POWDER: {
+                            update_powder(x, y);
+                            break;
+                        }
+                        case Materials::Rule::WATER: {
+                            waterBegin = std::min(waterBegin, x);
+                            waterEnd = x + 1;
+                            break;
+                        }
+                    }
+                }
+            }
+            if (waterBegin >= waterEnd) continue;
+
+            Water::Row water;
+            water.above = map[y - 1];
+            water.cells = scratch.cells.data() + 1;
+            water.swept = map[y];
+            water.below = map[y + 1];
+            water.down = scratch.down.data() + 1;
+            water.right = scratch.right.data() + 1;
+            water.left = scratch.left.data() + 1;
+            water.up = scratch.up.data() + 1;
+            water.air = AIR;
+            water.water = WATER;
+
+            for (int32_t i = chunkRow.begin; i < chunkRow.end; i ++) {
+                if (chunks[scheduled[i]].sleeping) continue;
+                // run of awake chunks
+                int32_t cx = scheduled[i] - chunkRow.cy * cw;
+                int32_t x0 = cx * chunkSize;
+                while (i + 1 < chunkRow.end && scheduled[i + 1] == scheduled[i] + 1 && !chunks[scheduled[i + 1]].sleeping) {
+                    i ++;
+                    cx ++;
+                }
+                int32_t x1 = std::min(w, (cx + 1) * chunkSize);
+                // cells without water have no outgoing flow, so the run can be
+                // trimmed to the water in it without changing any sum
+                x0 = std::max(x0, waterBegin);
+                x1 = std::min(x1, waterEnd);
+                if (x0 >= x1) continue;
+
+                water.right[x0 - 1] = 0;
+                water.left[x1] = 0;
+                Water::flows(kernel, water, x0, x1);
+                if (model == WaterModel::PRESSURE) {
+                    holdEnclosed(water, x0, x1);
+                }
+                Water::apply(kernel, water, mapBuffer[y - 1], mapBuffer[y], mapBuffer[y + 1], x0, x1);
+                mapBuffer[y][x0 - 1].mass = Cell::addUnits(mapBuffer[y][x0 - 1].mass, water.left[x0]);
+                mapBuffer[y][x1].mass = Cell::addUnits(mapBuffer[y][x1].mass, water.right[x1 - 1]);
+
+                for (int32_t x = x0; x < x1; x ++) {
+                    if (std::max(std::max(water.down[x], water.up[x]), std::max(water.right[x], water.left[x])) > 0) {
+                        flowed(x, y, x, y + 1, water.down[x]);
+                        flowed(x, y, x + 1, y, water.right[x]);
+                        flowed(x, y, x - 1, y, water.left[x]);
+                        flowed(x, y, x, y - 1, water.up[x]);
+                    }
+                }
+            }
+        }
+    }
+
+    // in place, left to right on even ticks and right to left on odd ones
+    void sweepChunkRowInPlace(const ChunkRow& chunkRow) {
+        int32_t y0 = chunkRow.cy * chunkSize;
+        int32_t y1 = std::min(h, y0 + chunkSize);
+        int dir = parity ? -1 : 1;
+        for (int y = y1 - 1; y >= y0; y --) {
+            for (int32_t i = 0; i < chunkRow.end - chunkRow.begin; i ++) {
+                int32_t index = scheduled[dir > 0 ? chunkRow.begin + i : chunkRow.end - 1 - i];
+                if (chunks[index].sleeping) continue;
+                int32_t cx = index - chunkRow.cy * cw;
+                int x0 = cx * chunkSize;
+                int x1 = std::min(w, x0 + chunkSize);
+                if (dir > 0) {
+                    for (int x = x0; x < x1; x ++) {
+                        updateInPlace(x, y, dir);
+                    }
+                } else {
+                    for (int x = x1 - 1; x >= x0; x --) {
+                        updateInPlace(x, y, dir);
+                    }
+                }
+            }
+        }
+    }
+
+    // turn mass into water and copy the buffer back into map
+    void commitChunk(int32_t cx, int32_t cy) {
+        int32_t x0 = cx * chunkSize;
+        int32_t x1 = std::min(w, x0 + chunkSize);
+        int32_t y1 = std::min(h, (cy + 1) * chunkSize);
+        for (int32_t y = cy * chunkSize; y < y1; y ++) {
+            Cell* row = map[y];
+            Cell* rowBuffer = mapBuffer[y];
+            for (int32_t x = x0; x < x1; x ++) {
+                Cell cell = rowBuffer[x];
+                if (Materials::lookup.fluid[cell.type] && cell.mass > Water::minUnits) {
+                    cell.type = WATER;
+                }
+                bool sameType = cell.type == row[x].type;
+                if (!sameType) {
+                    markChanged(x, y);
+                }
+                cell.flags = sameType && cell.mass == row[x].mass ? Cell::SLEEPING : 0;
+                row[x] = cell;
+                rowBuffer[x] = cell;
+            }
+        }
+        if (color) {
+            colorChunk(cx, cy);
+        }
+    }
+
+    void colorChunk(int32_t cx, int32_t cy);
+
+    void sweepChunkRow(const ChunkRow& chunkRow) {
+        if (inPlaceEnabled) {
+            sweepChunkRowInPlace(chunkRow);
+        } else if (kernel == Water::SCALAR) {
+            sweepChunkRowScalar(chunkRow);
+        } else {
+            sweepChunkRowVector(chunkRow);
+        }
+    }
+
+    void resetChunkRow(const ChunkRow& chunkRow) {
+        for (int32_t i = chunkRow.begin; i < chunkRow.end; i ++) {
+            if (!chunks[scheduled[i]].sleeping) {
+                resetChunk(scheduled[i] - chunkRow.cy * cw, chunkRow.cy);
+            }
+        }
+    }
+
+    void commitChunkRow(const ChunkRow& chunkRow) {
+        for (int32_t i = chunkRow.begin; i < chunkRow.end; i ++) {
+            const Chunk& chunk = chunks[scheduled[i]];
+            if (!chunk.sleeping || chunk.touched.load(std::memory_order_relaxed)) {
+                commitChunk(scheduled[i] - chunkRow.cy * cw, chunkRow.cy);
+            }
+        }
+    }
+
+    void wakeChunk(int32_t cx, int32_t cy) {
+        if (0 <= cx && cx < cw && 0 <= cy && cy < ch) {
+            wakeIndex(cy * cw + cx);
+        }
+    }
+
+    // the rows of scheduled of one parity, the bands of the parallel sweep that are swept at once
+    const std::vector<ChunkRow>& bandsOf(int32_t phase) {
+        bands.clear();
+        for (const ChunkRow& chunkRow : scheduledRows) {
+            if ((chunkRow.cy & 1) == phase) {
+                bands.push_back(chunkRow);
+            }
+        }
+        return bands;
+    }
+
+    void beginTick();
+    void endTick();
+
+public:
+    Simulation(int32_t width = 0, int32_t height = 0);
+
+    int32_t width() const {
+        return w;
+    }
+
+    int32_t height() const {
+        return h;
+    }
+
+    uint64_t tickCount() const {
+        return ticks;
+    }
+
+    // e.g. when restoring a saved world, the in-place update keys its parity to it
+    void setTickCount(uint64_t tick);
+
+    // 1 runs the original serial sweep, more runs the banded parallel sweep
+    void setThreads(int32_t threads);
+
+    int32_t threads() const {
+        return pool ? pool->size() : 1;
+    }
+
+    // FNV-1a over the type and mass of every cell, for comparing runs
+    uint64_t stateHash() const;
+
+    int32_t chunkCount() const {
+        return cw * ch;
+    }
+
+    // chunks that were awake during the last tick
+    int32_t activeChunks() const {
+        return active;
+    }
+
+    // false keeps every chunk awake, which sweeps the whole world like the
+    // original rules do, e.g. to compare against another backend
+    void setChunkSleeping(bool enabled) {
+        sleepEnabled = enabled;
+    }
+
+    bool chunkSleeping() const {
+        return sleepEnabled;
+    }
+
+    // true updates map in place without mapBuffer, see above
+    void setInPlace(bool enabled);
+
+    // how water moves, see above
+    void setWaterModel(WaterModel waterModel);
+
+    WaterModel waterModel() const {
+        return model;
+    }
+
+    bool inPlace() const {
+        return inPlaceEnabled;
+    }
+
+    // append the regions changed since the last call, one per chunk
+    void takeDirtyRects(std::vector<Rect>& rects);
+
+    // the type of every cell is its low byte, see Cell.hpp
+    const Grid<Cell>& cells() const {
+        return map;
+    }
+
+    CellID get(int32_t x, int32_t y) const {
+        return static_cast<CellID>(map(x, y).type);
+    }
+
+    float getMass(int32_t x, int32_t y) const {
+        return map(x, y).massValue();
+    }
+
+    // coordinates outside the world are ignored
+    void set(int32_t x, int32_t y, CellID id, float cellMass = 0.0);
+
+    // set() of length cells from (x, y) to the right, clipped to the world, waking and redrawing each chunk once
+    void fillRow(int32_t x, int32_t y, int32_t length, CellID id, float cellMass = 0.0);
+
+    // replace rows [y0, y1) with width() cells each, row y read from cells + (y - y0) * stride
+    void assignRows(int32_t y0, int32_t y1, const Cell* cells, ptrdiff_t stride);
+
+    static float calcFlow(float totalMass) {
+        return Water::calcFlow(totalMass);
+    }
+
+    // returns false and keeps the current kernel if the CPU lacks the instructions
+    bool setWaterKernel(Water::Kernel waterKernel);
+
+    Water::Kernel waterKernel() const {
+        return kernel;
+    }
+
+    // time the reset, sweep and commit passes of tick() as zones of profiler, nullptr turns it off
+    void setProfiler(Profiler* zones) {
+        profiler = zones;
+    }
+
+    // with a color target the commit pass also colors every chunk it commits, the in place update never colors
+    void tick(const ColorTarget* target = nullptr);
+};
+
+namespace SimulationDetail {
+    inline int32_t lowestBit(uint32_t bits) {
+#if defined(__GNUC__)
+        return __builtin_ctz(bits);
+#else
+        int32_t i = 0;
+        while (!(bits & 1u)) {
+            bits >>= 1;
+            i ++;
+        }
+        return i;
+#endif
+    }
+
+    inline int32_t highestBit(uint32_t bits) {
+#if defined(__GNUC__)
+        return 31 - __builtin_clz(bits);
+#else
+        int32_t i = 31;
+        while (!(bits & 0x80000000u)) {
+            bits <<= 1;
+            i --;
+        }
+        return i;
+#endif
+    }
+};
+
+inline Simulation::Simulation(int32_t width, int32_t height) {
+    w = width;
+    h = height;
+    ticks = 0;
+    map = Grid<Cell>(w, h, Cell(AIR));
+    mapBuffer = Grid<Cell>(w, h, Cell(AIR));
+    // the halo behaves like a wall, so nothing leaves the world
+    map.fillHalo(Cell(WALL));
+    mapBuffer.fillHalo(Cell(WALL));
+
+    cw = (w + chunkSize - 1) / chunkSize;
+    ch = (h + chunkSize - 1) / chunkSize;
+    chunks = std::vector<Chunk>(static_cast<size_t>(cw) * ch);
+    // every chunk starts awake, woken and dirty
+    awake.resize(chunks.size());
+    for (size_t i = 0; i < chunks.size(); i ++) {
+        awake[i] = static_cast<int32_t>(i);
+    }
+    waking = awake;
+    dirtyChunks = awake;
+    active = 0;
+    sleepEnabled = true;
+    inPlaceEnabled = false;
+    parity = 0;
+    model = WaterModel::MASS;
+    bodyStamp = 0;
+    profiler = nullptr;
+    color = nullptr;
+
+    kernel = Water::bestKernel();
+}
+
+inline void Simulation::set(int32_t x, int32_t y, CellID id, float cellMass) {
+    if (!map.contains(x, y)) {
+        return;
+    }
+    // not moved during the next tick
+    uint8_t stale = (ticks & 1) ? 0 : Cell::UPDATED;
+    map(x, y) = Cell(id, Cell::toUnits(cellMass), stale);
+    if (!inPlaceEnabled) {
+        mapBuffer(x, y) = map(x, y);
+    }
+
+    edited(x, y);
+}
+
+// the cells of the chunk that changed during this tick, into color's pixels
+inline void Simulation::colorChunk(int32_t cx, int32_t cy) {
+    using namespace SimulationDetail;
+    const Chunk& chunk = chunks[cy * cw + cx];
+    uint32_t rows = chunk.changedRows.load(std::memory_order_relaxed);
+    uint32_t cols = chunk.changedCols.load(std::memory_order_relaxed);
+    if (!rows) {
+        return;
+    }
+    int32_t x = cx * chunkSize + lowestBit(cols);
+    int32_t length = cx * chunkSize + highestBit(cols) + 1 - x;
+    for (; rows; rows &= rows - 1) {
+        int32_t y = cy * chunkSize + lowestBit(rows);
+        Canvas::blitIndexedRow(color->pixels + y * color->stride + x, reinterpret_cast<const int32_t*>(map[y] + x), length,
+            color->palette, color->paletteSize, 0xff);
+    }
+}
+
+inline void Simulation::fillRow(int32_t x, int32_t y, int32_t length, CellID id, float cellMass) {
+    if (x < 0) {
+        length += x;
+        x = 0;
+    }
+    length = std::min(length, w - x);
+    if (y < 0 || y >= h || length <= 0) {
+        return;
+    }
+    uint8_t stale = (ticks & 1) ? 0 : Cell::UPDATED;
+    std::fill(map[y] + x, map[y] + x + length, Cell(id, Cell::toUnits(cellMass), stale));
+    if (!inPlaceEnabled) {
+        std::copy(map[y] + x, map[y] + x + length, mapBuffer[y] + x);
+    }
+
+    int32_t end = x + length - 1;
+    for (int32_t cx = x >> chunkShift; cx <= end >> chunkShift; cx ++) {
+        int32_t first = std::max(x, cx * chunkSize) & chunkMask;
+        int32_t last = std::min(end, cx * chunkSize + chunkMask) & chunkMask;
+        markDirty((y >> chunkShift) * cw + cx, 1u << (y & chunkMask), (~0u >> (31 - last)) & (~0u << first));
+    }
+    // the chunks of the cells next to the row, as set() wakes them
+    int32_t cx0 = std::max(x - 1, 0) >> chunkShift;
+    int32_t cx1 = std::min(end + 1, w - 1) >> chunkShift;
+    int32_t cy0 = std::max(y - 1, 0) >> chunkShift;
+    int32_t cy1 = std::min(y + 1, h - 1) >> chunkShift;
+    for (int32_t cy = cy0; cy <= cy1; cy ++) {
+        for (int32_t cx = cx0; cx <= cx1; cx ++) {
+            wakeIndex(cy * cw + cx);
+        }
+    }
+}
+
+inline void Simulation::setTickCount(uint64_t tick) {
+    ticks = tick;
+    if (inPlaceEnabled) {
+        parity = (ticks & 1) ? Cell::UPDATED : 0;
+        for (int32_t cy = 0; cy < ch; cy ++) {
+            for (int32_t cx = 0; cx < cw; cx ++) {
+                resetParity(cx, cy);
+            }
+        }
+    }
+}
+
+inline void Simulation::assignRows(int32_t y0, int32_t y1, const Cell* cells, ptrdiff_t stride) {
+    y0 = std::max(y0, 0);
+    y1 = std::min(y1, h);
+    if (y0 >= y1) {
+        return;
+    }
+    for (int32_t y = y0; y < y1; y ++) {
+        memcpy(map[y], cells + (y - y0) * stride, w * sizeof(Cell));
+    }
+    if (inPlaceEnabled) {
+        // not moved during the next tick
+        parity = (ticks & 1) ? Cell::UPDATED : 0;
+        for (int32_t cy = y0 >> chunkShift; cy <= (y1 - 1) >> chunkShift; cy ++) {
+            for (int32_t cx = 0; cx < cw; cx ++) {
+                resetParity(cx, cy);
+            }
+        }
+    } else {
+        mapBuffer.copyRowsFrom(map, y0, y1);
+    }
+
+    // wake and redraw the chunks of the rows, and the ones next to them
+    int32_t cy0 = std::max(0, (y0 >> chunkShift) - 1);
+    int32_t cy1 = std::min(ch - 1, ((y1 - 1) >> chunkShift) + 1);
+    for (int32_t cy = cy0; cy <= cy1; cy ++) {
+        for (int32_t cx = 0; cx < cw; cx ++) {
+            wakeIndex(cy * cw + cx);
+            markDirty(cy * cw + cx, ~0u, ~0u);
+        }
+    }
+}
+
+inline void Simulation::takeDirtyRects(std::vector<Rect>& rects) {
+    using namespace SimulationDetail;
+    // in the order of a scan over the world
+    std::sort(dirtyChunks.begin(), dirtyChunks.end());
+    for (int32_t i : dirtyChunks) {
+        Chunk& chunk = chunks[i];
+        int32_t cx = i % cw;
+        int32_t cy = i / cw;
+        int32_t x0 = cx * chunkSize + lowestBit(chunk.dirtyCols);
+        int32_t y0 = cy * chunkSize + lowestBit(chunk.dirtyRows);
+        int32_t x1 = std::min(w, cx * chunkSize + highestBit(chunk.dirtyCols) + 1);
+        int32_t y1 = std::min(h, cy * chunkSize + highestBit(chunk.dirtyRows) + 1);
+        rects.emplace_back(x0, y0, x1 - x0, y1 - y0);
+        chunk.dirtyRows = 0;
+        chunk.dirtyCols = 0;
+    }
+    dirtyChunks.clear();
+}
+
+inline void Simulation::setInPlace(bool enabled) {
+    if (enabled == inPlaceEnabled) {
+        return;
+    }
+    inPlaceEnabled = enabled;
+    if (enabled) {
+        mapBuffer = Grid<Cell>();
+        parity = (ticks & 1) ? Cell::UPDATED : 0;
+        for (int32_t cy = 0; cy < ch; cy ++) {
+            for (int32_t cx = 0; cx < cw; cx ++) {
+                resetParity(cx, cy);
+            }
+        }
+    } else {
+        mapBuffer = map;
+    }
+}
+
+inline bool Simulation::setWaterKernel(Water::Kernel waterKernel) {
+    if (!Water::kernelSupported(waterKernel)) {
+        return false;
+    }
+    kernel = waterKernel;
+    return true;
+}
+
+inline void Simulation::setThreads(int32_t threads) {
+    if (threads > 1) {
+        pool.reset(new ThreadPool(threads));
+    } else {
+        pool.reset();
+    }
+}
+
+inline uint64_t Simulation::stateHash() const {
+    uint64_t hash = 1469598103934665603ull;
+    for (int32_t y = 0; y < h; y ++) {
+        const Cell* row = map[y];
+        for (int32_t x = 0; x < w; x ++) {
+            hash = (hash ^ static_cast<uint64_t>(row[x].type)) * 1099511628211ull;
+            hash = (hash ^ static_cast<uint64_t>(row[x].mass)) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+inline void Simulation::setWaterModel(WaterModel waterModel) {
+    model = waterModel;
+    if (model == WaterModel::PRESSURE) {
+        bodyVisits.assign(static_cast<size_t>(w) * h, 0);
+        bodyStamp = 0;
+    } else {
+        std::vector<uint32_t>().swap(bodyVisits);
+    }
+}
+
+// every body with water in an awake chunk, each once
+inline void Simulation::levelWaterBodies() {
+    if (++ bodyStamp == 0) {
+        std::fill(bodyVisits.begin(), bodyVisits.end(), 0);
+        bodyStamp = 1;
+    }
+    for (int32_t i : awake) {
+        int32_t x0 = (i % cw) * chunkSize;
+        int32_t x1 = std::min(w, x0 + chunkSize);
+        int32_t y0 = (i / cw) * chunkSize;
+        int32_t y1 = std::min(h, y0 + chunkSize);
+        for (int32_t y = y0; y < y1; y ++) {
+            const Cell* row = map[y];
+            for (int32_t x = x0; x < x1; x ++) {
+                if (row[x].type == WATER && bodyVisits[static_cast<size_t>(y) * w + x] != bodyStamp) {
+                    levelBody(x, y);
+                }
+            }
+        }
+    }
+}
+
+// level the body of water at (x, y), cells are indexed y * w + x so the order of indices is the order of rows
+inline void Simulation::levelBody(int32_t x, int32_t y) {
+    bodyStack.clear();
+    bodySurface.clear();
+    bodyOpen.clear();
+    auto visit = [&](int32_t i) {
+        bool seen = bodyVisits[i] == bodyStamp;
+        bodyVisits[i] = bodyStamp;
+        return !seen;
+    };
+    visit(y * w + x);
+    bodyStack.push_back(y * w + x);
+    while (!bodyStack.empty()) {
+        int32_t i = bodyStack.back();
+        bodyStack.pop_back();
+        int32_t cx = i % w;
+        int32_t cy = i / w;
+        if (map[cy - 1][cx].type == AIR) {
+            bodySurface.push_back(i);
+        }
+        // the halo is WALL, neither water nor air
+        const int32_t next[4][2] = {{cx - 1, cy}, {cx + 1, cy}, {cx, cy - 1}, {cx, cy + 1}};
+        for (const int32_t* n : next) {
+            uint8_t type = map[n[1]][n[0]].type;
+            if (type == WATER && visit(n[1] * w + n[0])) {
+                bodyStack.push_back(n[1] * w + n[0]);
+            } else if (type == AIR && restingOpen(n[0], n[1]) && visit(n[1] * w + n[0])) {
+                bodyOpen.push_back(n[1] * w + n[0]);
+            }
+        }
+    }
+
+    // highest surface first, lowest open cell first
+    std::greater<int32_t> highest;
+    std::less<int32_t> lowest;
+    std::make_heap(bodySurface.begin(), bodySurface.end(), highest);
+    std::make_heap(bodyOpen.begin(), bodyOpen.end(), lowest);
+    uint8_t flags = inPlaceEnabled ? parity : 0;
+    while (!bodySurface.empty() && !bodyOpen.empty() && bodyOpen.front() / w > bodySurface.front() / w) {
+        std::pop_heap(bodySurface.begin(), bodySurface.end(), highest);
+        int32_t from = bodySurface.back();
+        bodySurface.pop_back();
+        int32_t fx = from % w;
+        int32_t fy = from / w;
+        // covered by a cell moved before
+        if (map[fy][fx].type != WATER || map[fy - 1][fx].type != AIR) continue;
+        std::pop_heap(bodyOpen.begin(), bodyOpen.end(), lowest);
+        int32_t to = bodyOpen.back();
+        bodyOpen.pop_back();
+        int32_t tx = to % w;
+        int32_t ty = to / w;
+
+        Cell moved = map[fy][fx];
+        map[ty][tx] = Cell(WATER, Cell::addUnits(map[ty][tx].mass, moved.mass), flags);
+        map[fy][fx] = Cell(AIR, 0, flags);
+        if (!inPlaceEnabled) {
+            mapBuffer[ty][tx] = map[ty][tx];
+            mapBuffer[fy][fx] = map[fy][fx];
+        }
+        for (int32_t i : {from, to}) {
+            int32_t cx = i % w;
+            int32_t cy = i / w;
+            edited(cx, cy);
+            if (color) {
+                Canvas::blitIndexedRow(color->pixels + cy * color->stride + cx, reinterpret_cast<const int32_t*>(map[cy] + cx), 1,
+                    color->palette, color->paletteSize, 0xff);
+            }
+        }
+
+        // the water under the moved cell is the surface now, and so is the filled cell
+        if (map[fy + 1][fx].type == WATER && bodyVisits[from + w] == bodyStamp) {
+            bodySurface.push_back(from + w);
+            std::push_heap(bodySurface.begin(), bodySurface.end(), highest);
+        }
+        if (map[ty - 1][tx].type == AIR) {
+            bodySurface.push_back(to);
+            std::push_heap(bodySurface.begin(), bodySurface.end(), highest);
+        }
+        // the filled cell holds up the air above it and lets the water reach the air beside it
+        const int32_t next[3][2] = {{tx - 1, ty}, {tx + 1, ty}, {tx, ty - 1}};
+        for (const int32_t* n : next) {
+            if (restingOpen(n[0], n[1]) && visit(n[1] * w + n[0])) {
+                bodyOpen.push_back(n[1] * w + n[0]);
+                std::push_heap(bodyOpen.begin(), bodyOpen.end(), lowest);
+            }
+        }
+    }
+}
+
+inline void Simulation::beginTick() {
+    parity = (ticks & 1) ? Cell::UPDATED : 0;
+    if (!sleepEnabled) {
+        for (int32_t i = 0; i < cw * ch; i ++) {
+            wakeIndex(i);
+        }
+    }
+    for (int32_t i : awake) {
+        chunks[i].sleeping = !chunks[i].wake;
+    }
+    awake.swap(waking);
+    waking.clear();
+    std::sort(awake.begin(), awake.end());
+    for (int32_t i : awake) {
+        Chunk& chunk = chunks[i];
+        // flags of a chunk that slept may hold the parity of any earlier tick
+        if (inPlaceEnabled && chunk.sleeping) {
+            resetParity(i % cw, i / cw);
+        }
+        chunk.sleeping = false;
+        chunk.wake = false;
+    }
+    active = static_cast<int32_t>(awake.size());
+
+    // the awake chunks and their neighbors, material moves at most a cell per tick
+    scheduled.clear();
+    for (int32_t i : awake) {
+        int32_t cx = i % cw;
+        int32_t cy = i / cw;
+        for (int32_t ny = std::max(cy - 1, 0); ny <= std::min(cy + 1, ch - 1); ny ++) {
+            for (int32_t nx = std::max(cx - 1, 0); nx <= std::min(cx + 1, cw - 1); nx ++) {
+                Chunk& chunk = chunks[ny * cw + nx];
+                if (chunk.scheduled) continue;
+                chunk.scheduled = true;
+                chunk.touched.store(0, std::memory_order_relaxed);
+                chunk.changedRows.store(0, std::memory_order_relaxed);
+                chunk.changedCols.store(0, std::memory_order_relaxed);
+                scheduled.push_back(ny * cw + nx);
+            }
+        }
+    }
+    std::sort(scheduled.begin(), scheduled.end());
+    scheduledRows.clear();
+    for (int32_t begin = 0; begin < static_cast<int32_t>(scheduled.size()); ) {
+        int32_t cy = scheduled[begin] / cw;
+        int32_t end = begin + 1;
+        while (end < static_cast<int32_t>(scheduled.size()) && scheduled[end] / cw == cy) {
+            end ++;
+        }
+        scheduledRows.push_back({cy, begin, end});
+        begin = end;
+    }
+}
+
+// keep every changed chunk awake, and its neighbors where a change touches the border
+inline void Simulation::endTick() {
+    for (int32_t i : scheduled) {
+        Chunk& chunk = chunks[i];
+        chunk.scheduled = false;
+        uint32_t rows = chunk.changedRows.load(std::memory_order_relaxed);
+        uint32_t cols = chunk.changedCols.load(std::memory_order_relaxed);
+        if (!rows) continue;
+        wakeIndex(i);
+        markDirty(i, rows, cols);
+
+        int32_t cx = i % cw;
+        int32_t cy = i / cw;
+        int32_t top = (rows & 1u) ? -1 : 0;
+        int32_t bottom = (rows & 0x80000000u) ? 1 : 0;
+        int32_t left = (cols & 1u) ? -1 : 0;
+        int32_t right = (cols & 0x80000000u) ? 1 : 0;
+        for (int32_t dy = top; dy <= bottom; dy ++) {
+            for (int32_t dx = left; dx <= right; dx ++) {
+                wakeChunk(cx + dx, cy + dy);
+            }
+        }
+    }
+    ticks ++;
+}
+
+inline void Simulation::tick(const ColorTarget* target) {
+    beginTick();
+    color = target;
+    int32_t rows = static_cast<int32_t>(scheduledRows.size());
+    if (inPlaceEnabled) {
+        ProfileZone zone(profiler, "sim sweep");
+        if (!pool) {
+            for (int32_t i = rows - 1; i >= 0; i --) {
+                sweepChunkRow(scheduledRows[i]);
+            }
+        } else {
+            for (int32_t phase = 0; phase < 2; phase ++) {
+                const std::vector<ChunkRow>& band = bandsOf(phase);
+                pool->parallelFor(static_cast<int32_t>(band.size()), [&](int32_t i) {
+                    sweepChunkRow(band[i]);
+                });
+            }
+        }
+    } else if (!pool) {
+        {
+            ProfileZone zone(profiler, "sim reset");
+            for (int32_t i = 0; i < rows; i ++) {
+                resetChunkRow(scheduledRows[i]);
+            }
+        }
+        {
+            ProfileZone zone(profiler, "sim sweep");
+            for (int32_t i = rows - 1; i >= 0; i --) {
+                sweepChunkRow(scheduledRows[i]);
+            }
+        }
+        ProfileZone zone(profiler, "commit");
+        for (int32_t i = 0; i < rows; i ++) {
+            commitChunkRow(scheduledRows[i]);
+        }
+    } else {
+        {
+            ProfileZone zone(profiler, "sim reset");
+            pool->parallelFor(rows, [&](int32_t i) {
+                resetChunkRow(scheduledRows[i]);
+            });
+        }
+        {
+            ProfileZone zone(profiler, "sim sweep");
+            for (int32_t phase = 0; phase < 2; phase ++) {
+                const std::vector<ChunkRow>& band = bandsOf(phase);
+                pool->parallelFor(static_cast<int32_t>(band.size()), [&](int32_t i) {
+                    sweepChunkRow(band[i]);
+                });
+            }
+        }
+        ProfileZone zone(profiler, "commit");
+        pool->parallelFor(rows, [&](int32_t i) {
+            commitChunkRow(scheduledRows[i]);
+        });
+    }
+    if (model == WaterModel::PRESSURE) {
+        ProfileZone zone(profiler, "level water");
+        levelWaterBodies();
+    }
+    color = nullptr;
+    endTick();
+}
+
+#endif
@@ -0,0 +1,464 @@
+/**
+ * @file SimulationThread.hpp
+ * @brief Runs a Simulation on its own thread and publishes colored frames
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#ifndef SIMULATIONTHREAD_HPP
+#define SIMULATIONTHREAD_HPP
+
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Brush.hpp"
+#include "Canvas.hpp"
+#include "Profiler.hpp"
+#include "Replay.hpp"
+#include "Simulation.hpp"
+#include "Snapshot.hpp"
+#include "SpscQueue.hpp"
+#include "TripleBuffer.hpp"
+
+/*
+SimulationThread owns a Simulation once start() is called and ticks it at
+a fixed rate on a worker thread, so a blocking swap or a slow frame on the
+render thread does not hold the simulation back and a slow tick does not
+stall rendering.
+
+Edits reach the world as events through an SpscQueue: the render thread
+post()s them, the worker applies them before its next tick. An event is
+a brush stroke, the render thread posts one per frame and the worker
+rasterizes it and writes it a row at a time.
+
+After every batch of ticks that changed something the worker publishes
+the back frame of a TripleBuffer. A frame is a packed RGBA image of the
+whole world plus the regions that changed since the last frame the
+reader took, so the reader only has to copy and upload those.
+
+The last tick of a batch colors what it changes straight into the back
+frame as it commits (see Simulation::ColorTarget), the frame is never
+cleared and the cells are not read a second time for it. That only
+covers the chunks the back frame showed up to date before the tick: the
+slots are written in turns, and edits and the earlier ticks of a batch
+are not colored. Every change bumps a version of its chunk and every
+slot remembers the version of each chunk it shows, whatever a slot is
+behind on is colored from the cells before it is published.
+
+A snapshot requested by the render thread is written by the worker
+between two ticks, the world never has to leave the worker. The worker
+also stamps the edits it applies into a Recording, or feeds the edits of
+one back in, since only it knows which tick they land before.
+
+With FrameFormat::MATERIAL a frame holds no colors but the type byte and
+a mass byte of every cell, 2 bytes per cell instead of 4, for a reader
+that colors on the GPU. The worker then does no coloring at all, it
+copies the bytes of the chunks a frame is behind on.
+
+The worker profiles itself with its own Profiler, one profiler frame per
+batch of ticks, and every published Frame carries a copy of its stats.
+*/
+class SimulationThread {
+public:
+    // brush dragged from (x0, y0) to (x1, y1), a single cell when both are the same and the radius is 0
+    struct Event {
+        int32_t x0 = 0;
+        int32_t y0 = 0;
+        int32_t x1 = 0;
+        int32_t y1 = 0;
+        Brush brush;
+    };
+
+    enum class FrameFormat {
+        // colored with the palette
+        RGBA,
+        // cell type and mass bytes, for coloring on the GPU
+        MATERIAL
+    };
+
+    // mass byte of a MATERIAL frame, 1.0 is 128 and everything from 2.0 up is 255
+    static constexpr int32_t massByteShift = Cell::massShift - 7;
+
+    struct Frame {
+        // RGBA: width x height packed RGBA, rows without padding
+        std::vector<uint32_t> pixels;
+        // MATERIAL: width x height cell types and mass bytes, rows without padding
+        std::vector<uint8_t> ids;
+        std::vector<uint8_t> masses;
+        // regions changed since the previous frame the reader took
+        std::vector<Simulation::Rect> dirty;
+        uint64_t tick = 0;
+        int32_t activeChunks = 0;
+        int32_t chunkCount = 0;
+        // measured ticks per second
+        double tickRate = 0.0;
+        // zones of the worker, per batch of ticks
+        std::vector<Profiler::Stats> profile;
+    };
+
+    enum SnapshotState : int32_t {
+        SNAPSHOT_IDLE,
+        SNAPSHOT_REQUESTED,
+        SNAPSHOT_SAVED,
+        SNAPSHOT_FAILED
+    };
+
+    enum ReplayState : int32_t {
+        REPLAY_NONE,
+        REPLAY_RUNNING,
+        // the state hash at the end tick of the recording matched it or not
+        REPLAY_MATCHED,
+        REPLAY_DRIFTED
+    };
+
+private:
+    Simulation sim;
+    double step;
+    int32_t maxSubSteps;
+    std::vector<uint32_t> palette;
+    FrameFormat format;
+    int32_t chunkColumns;
+    // version of the last change of every chunk, and the version every slot shows
+    uint64_t version;
+    std::vector<uint64_t> changedAt;
+    std::vector<uint64_t> drawnAt[3];
+    // the back slot showed the chunk up to date before the coloring tick
+    std::vector<uint8_t> fresh;
+
+    SpscQueue<Event> events;
+    std::vector<BrushSpan> spans;
+    TripleBuffer<Frame> frames;
+    // regions changed since the last publish, and the ones the reader has not taken yet
+    std::vector<Simulation::Rect> changed;
+    std::vector<Simulation::Rect> unread;
+    double tickRate;
+    Recording* recording;
+    const Recording* replayed;
+    Replayer replayer;
+    // written once by the worker before replayState leaves REPLAY_RUNNING
+    uint64_t replayHash;
+    std::atomic<int32_t> replayState;
+    Profiler profiler;
+
+    std::thread worker;
+    std::atomic<bool> running;
+    std::atomic<int64_t> droppedTicks;
+
+    // only written by the render thread while no snapshot is requested
+    std::string snapshotPath;
+    SnapshotCompression snapshotCompression;
+    std::atomic<int32_t> snapshot;
+
+    // append rects, past one per chunk a single rect of the whole world is cheaper
+    void merge(std::vector<Simulation::Rect>& into, const std::vector<Simulation::Rect>& rects) {
+        if (into.size() == 1 && into[0].w == sim.width() && into[0].h == sim.height()) {
+            return;
+        }
+        into.insert(into.end(), rects.begin(), rects.end());
+        if (into.size() > static_cast<size_t>(sim.chunkCount())) {
+            into.assign(1, Simulation::Rect(0, 0, sim.width(), sim.height()));
+        }
+    }
+
+    void applyEvents() {
+        replayer.apply(sim, sim.tickCount());
+        Event event;
+        while (events.pop(event)) {
+            spans.clear();
+            rasterizeStroke(event.brush, event.x0, event.y0, event.x1, event.y1, sim.width(), sim.height(), spans);
+            const Brush& brush = event.brush;
+            for (const BrushSpan& span : spans) {
+                sim.fillRow(span.x, span.y, span.length, brush.material, brush.mass);
+                if (recording) {
+                    // recordings stay a list of cells
+                    for (int32_t x = span.x; x < span.x + span.length; x ++) {
+                        recording->record(sim.tickCount(), x, span.y, brush.material, brush.mass);
+                    }
+                }
+            }
+        }
+    }
+
+    size_t chunkIndex(const Simulation::Rect& rect) const {
+        return static_cast<size_t>(rect.y / Simulation::chunkSize) * chunkColumns + rect.x / Simulation::chunkSize;
+    }
+
+    // collect the simulation's dirty rects, one per chunk, as a new version of their chunks
+    void collectChanges() {
+        size_t first = changed.size();
+        sim.takeDirtyRects(changed);
+        if (changed.size() == first) {
+            return;
+        }
+        version ++;
+        for (size_t i = first; i < changed.size(); i ++) {
+            changedAt[chunkIndex(changed[i])] = version;
+        }
+    }
+
+    // tick and color the changes into the back frame, chunks the frame was up to date on stay up to date
+    void tickColored() {
+        collectChanges();
+        std::vector<uint64_t>& drawn = drawnAt[frames.backSlot()];
+        for (size_t chunk = 0; chunk < drawn.size(); chunk ++) {
+            fresh[chunk] = drawn[chunk] >= changedAt[chunk];
+        }
+        Simulation::ColorTarget target;
+        target.pixels = frames.back().pixels.data();
+        target.stride = sim.width();
+        target.palette = palette.data();
+        target.paletteSize = static_cast<int32_t>(palette.size());
+        sim.tick(&target);
+        collectChanges();
+        for (size_t chunk = 0; chunk < drawn.size(); chunk ++) {
+            if (fresh[chunk]) {
+                drawn[chunk] = version;
+            }
+        }
+    }
+
+    void publishFrame() {
+        collectChanges();
+        if (changed.empty()) {
+            return;
+        }
+
+        ProfileZone zone(&profiler, "colorize");
+        Frame& frame = frames.back();
+        Canvas canvas(reinterpret_cast<uint8_t*>(frame.pixels.data()), sim.width(), sim.height());
+        const Grid<Cell>& cells = sim.cells();
+        std::vector<uint64_t>& drawn = drawnAt[frames.backSlot()];
+        for (size_t chunk = 0; chunk < drawn.size(); chunk ++) {
+            if (drawn[chunk] >= changedAt[chunk]) {
+                continue;
+            }
+            int32_t x = static_cast<int32_t>(chunk % chunkColumns) * Simulation::chunkSize;
+            int32_t y = static_cast<int32_t>(chunk / chunkColumns) * Simulation::chunkSize;
+            int32_t width = std::min(Simulation::chunkSize, sim.width() - x);
+            int32_t height = std::min(Simulation::chunkSize, sim.height() - y);
+            if (format == FrameFormat::RGBA) {
+                const int32_t* indices = reinterpret_cast<const int32_t*>(cells[y] + x);
+                canvas.blitIndexed(x, y, width, height, indices, cells.stride(), palette.data(), palette.size(), 0xff);
+            } else {
+                for (int32_t row = y; row < y + height; row ++) {
+                    const Cell* from = cells[row] + x;
+                    size_t offset = static_cast<size_t>(row) * sim.width() + x;
+                    for (int32_t i = 0; i < width; i ++) {
+                        frame.ids[offset + i] = from[i].type;
+                        frame.masses[offset + i] = static_cast<uint8_t>(std::min(from[i].mass >> massByteShift, 255));
+                    }
+                }
+            }
+            drawn[chunk] = version;
+        }
+
+        // a reader that skipped frames still needs their regions
+        if (!frames.pending()) {
+            unread.clear();
+        }
+        merge(unread, changed);
+        changed.clear();
+        frame.dirty = unread;
+        frame.tick = sim.tickCount();
+        frame.activeChunks = sim.activeChunks();
+        frame.chunkCount = sim.chunkCount();
+        frame.tickRate = tickRate;
+        frame.profile = profiler.statistics();
+        frames.publish();
+    }
+
+    // compare the state at the end tick of the replayed recording with the recorded hash
+    void checkReplay() {
+        if (replayState.load(std::memory_order_relaxed) == REPLAY_RUNNING && replayer.finished(sim.tickCount())) {
+            replayHash = sim.stateHash();
+            replayState.store(replayHash == replayed->endHash() ? REPLAY_MATCHED : REPLAY_DRIFTED, std::memory_order_release);
+        }
+    }
+
+    void saveRequestedSnapshot() {
+        if (snapshot.load(std::memory_order_acquire) == SNAPSHOT_REQUESTED) {
+            ProfileZone zone(&profiler, "snapshot");
+            bool saved = saveSnapshot(snapshotPath, sim, snapshotCompression);
+            snapshot.store(saved ? SNAPSHOT_SAVED : SNAPSHOT_FAILED, std::memory_order_release);
+        }
+    }
+
+    void run() {
+        typedef std::chrono::steady_clock Clock;
+        Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(step));
+        Clock::time_point next = Clock::now();
+        Clock::time_point rateStart = next;
+        int64_t rateTicks = 0;
+
+        checkReplay();
+        publishFrame();
+        while (running.load(std::memory_order_relaxed)) {
+            saveRequestedSnapshot();
+            Clock::time_point now = Clock::now();
+            if (now < next) {
+                std::this_thread::sleep_until(next);
+                continue;
+            }
+
+            int32_t steps = 0;
+            while (next <= now && steps < maxSubSteps) {
+                ProfileZone zone(&profiler, "tick");
+                {
+                    ProfileZone edits(&profiler, "events");
+                    applyEvents();
+                }
+                // only the state after the batch is shown
+                if (format == FrameFormat::RGBA && (next + period > now || steps + 1 == maxSubSteps)) {
+                    tickColored();
+                } else {
+                    sim.tick();
+                }
+                checkReplay();
+                next += period;
+                steps ++;
+            }
+            if (next <= now) {
+                // more behind than the budget allows, run slower instead of spiraling
+                droppedTicks.fetch_add((now - next) / period + 1, std::memory_order_relaxed);
+                next = now + period;
+            }
+
+            rateTicks += steps;
+            double elapsed = std::chrono::duration<double>(now - rateStart).count();
+            if (elapsed >= 1.0) {
+                tickRate = rateTicks / elapsed;
+                rateTicks = 0;
+                rateStart = now;
+            }
+            publishFrame();
+            profiler.endFrame();
+        }
+    }
+
+public:
+    // step is the simulated time of one tick in seconds, palette colors the cell ids as Canvas::rgba(), MATERIAL frames ignore it
+    SimulationThread(Simulation&& simulation, double step, int32_t maxSubSteps, const uint32_t* palette, int32_t paletteSize,
+        FrameFormat format = FrameFormat::RGBA)
+        : sim(std::move(simulation)), step(step), maxSubSteps(maxSubSteps), palette(palette, palette + paletteSize), format(format),
+          events(4096), tickRate(0.0), recording(nullptr), replayed(nullptr), replayHash(0), replayState(REPLAY_NONE), profiler("simulation", 1), running(false), droppedTicks(0),
+          snapshotCompression(SnapshotCompression::NONE), snapshot(SNAPSHOT_IDLE) {
+        sim.setProfiler(&profiler);
+        chunkColumns = (sim.width() + Simulation::chunkSize - 1) / Simulation::chunkSize;
+        size_t cells = static_cast<size_t>(sim.width()) * sim.height();
+        // every slot is behind on every chunk
+        version = 1;
+        changedAt.assign(sim.chunkCount(), version);
+        for (int32_t i = 0; i < 3; i ++) {
+            if (format == FrameFormat::RGBA) {
+                frames.slot(i).pixels.assign(cells, 0);
+            } else {
+                frames.slot(i).ids.assign(cells, 0);
+                frames.slot(i).masses.assign(cells, 0);
+            }
+            drawnAt[i].assign(sim.chunkCount(), 0);
+        }
+        fresh.assign(sim.chunkCount(), 0);
+    }
+
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    ~SimulationThread() {
+        stop();
+    }
+
+    void start() {
+        if (!running.exchange(true)) {
+            worker = std::thread(&SimulationThread::run, this);
+        }
+    }
+
+    void stop() {
+        running.store(false);
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+    int32_t width() const {
+        return sim.width();
+    }
+
+    int32_t height() const {
+        return sim.height();
+    }
+
+    // render thread: queue an edit, false if the queue is full and the edit was dropped
+    bool post(const Event& event) {
+        return events.push(event);
+    }
+
+    // render thread: the newest finished frame, nullptr if there is none since the last call
+    const Frame* latest() {
+        return frames.update() ? &frames.front() : nullptr;
+    }
+
+    // render thread: save the world to path between two ticks, false while the last request is pending
+    bool requestSnapshot(const std::string& path, SnapshotCompression compression = SnapshotCompression::NONE) {
+        if (snapshot.load(std::memory_order_acquire) == SNAPSHOT_REQUESTED) {
+            return false;
+        }
+        snapshotPath = path;
+        snapshotCompression = compression;
+        snapshot.store(SNAPSHOT_REQUESTED, std::memory_order_release);
+        return true;
+    }
+
+    // outcome of the last requestSnapshot()
+    SnapshotState snapshotState() const {
+        return static_cast<SnapshotState>(snapshot.load(std::memory_order_acquire));
+    }
+
+    // only while the thread is stopped: stamp every edit into recording, nullptr stops recording
+    void record(Recording* into) {
+        recording = into;
+    }
+
+    // only while the thread is stopped: apply the edits of replay before the ticks they were made before
+    void replay(const Recording* replay) {
+        replayed = replay;
+        replayer = Replayer(replay);
+        replayState.store(replay ? REPLAY_RUNNING : REPLAY_NONE, std::memory_order_relaxed);
+    }
+
+    // whether the replay reached the end of its recording with the recorded state
+    ReplayState replayResult() const {
+        return static_cast<ReplayState>(replayState.load(std::memory_order_acquire));
+    }
+
+    // the state hash at the end of the recording, once replayResult() is past REPLAY_RUNNING
+    uint64_t replayStateHash() const {
+        return replayHash;
+    }
+
+    // only while the thread is stopped: share the worker's profile frames with log
+    void setProfileLog(ProfileLog* log) {
+        profiler.setLog(log);
+    }
+
+    // ticks skipped because the worker could not keep up
+    int64_t skippedTicks() const {
+        return droppedTicks.load(std::memory_order_relaxed);
+    }
+
+    // the simulation itself, only while the thread is stopped, it still reports to the worker's profiler
+    Simulation& simulation() {
+        return sim;
+    }
+};
+
+#endif
@@ -0,0 +1,347 @@
+/**
+ * @file Snapshot.hpp
+ * @brief Versioned binary world snapshots, loaded through mmap
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SNAPSHOT_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define SNAPSHOT_MMAP 0
+#endif
+
+#include "Cell.hpp"
+#include "Grid.hpp"
+#include "Simulation.hpp"
+
+/*
+A snapshot is a SnapshotHeader followed by the cells of the world:
+
+NONE    width x height Cells row after row, the same words Simulation
+        keeps in memory. Loading maps the file and copies the rows
+        straight into the grid, nothing is decoded.
+RLE     the rows in bands of bandRows, a table of band count + 1 payload
+        offsets, then every band as runs of a uint32_t count followed by
+        the repeated Cell. Bands decode independently of each other.
+
+cellSize and massShift record the cell encoding; a file whose cells do
+not match Cell.hpp is rejected instead of misread. Files are written in
+the byte order of the machine, a big-endian reader sees a wrong version
+and rejects them as well. The sizes in the header are checked against
+the file, and worlds larger than maxSide on a side or maxCells in all
+are refused, before any memory is allocated for the world.
+*/
+enum class SnapshotCompression : uint32_t {
+    NONE,
+    RLE
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    // offset of the payload
+    uint32_t headerSize;
+    int32_t width;
+    int32_t height;
+    uint64_t tick;
+    uint32_t cellSize;
+    uint32_t massShift;
+    uint32_t compression;
+    uint32_t bandRows;
+    // bytes after the header
+    uint64_t payloadSize;
+    uint8_t reserved[8];
+};
+
+static_assert(sizeof(SnapshotHeader) == 64, "the snapshot header is 64 bytes");
+
+namespace SnapshotDetail {
+    constexpr char magic[8] = {'S', 'A', 'N', 'D', 'S', 'N', 'A', 'P'};
+    constexpr uint32_t version = 1;
+    constexpr int32_t bandRows = Simulation::chunkSize;
+    // larger worlds are refused before anything is allocated for them, the chunk and
+    // cell index math of Simulation stays in int32_t below these
+    constexpr int32_t maxSide = 1 << 16;
+    constexpr uint64_t maxCells = uint64_t(1) << 30;
+
+    // a read-only view of a whole file, mapped where the platform can
+    class MappedFile {
+    private:
+        const uint8_t* bytes;
+        size_t length;
+        std::vector<uint8_t> copy;
+
+    public:
+        MappedFile() : bytes(nullptr), length(0) {}
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        ~MappedFile() {
+#if SNAPSHOT_MMAP
+            if (bytes && copy.empty()) {
+                munmap(const_cast<uint8_t*>(bytes), length);
+            }
+#endif
+        }
+
+        bool open(const std::string& path) {
+#if SNAPSHOT_MMAP
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return false;
+            }
+            struct stat info;
+            if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+                ::close(fd);
+                return false;
+            }
+            void* address = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (address == MAP_FAILED) {
+                return false;
+            }
+            madvise(address, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+            bytes = static_cast<const uint8_t*>(address);
+            length = static_cast<size_t>(info.st_size);
+            return true;
+#else
+            FILE* file = fopen(path.c_str(), "rb");
+            if (!file) {
+                return false;
+            }
+            uint8_t buffer[1 << 16];
+            size_t count;
+            while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+                copy.insert(copy.end(), buffer, buffer + count);
+            }
+            fclose(file);
+            bytes = copy.data();
+            length = copy.size();
+            return length > 0;
+#endif
+        }
+
+        const uint8_t* data() const {
+            return bytes;
+        }
+
+        size_t size() const {
+            return length;
+        }
+    };
+
+    inline uint32_t word(const Cell& cell) {
+        uint32_t value;
+        memcpy(&value, &cell, sizeof(value));
+        return value;
+    }
+
+    // append rows [y0, y1) as runs of equal cells
+    inline void encodeBand(const Grid<Cell>& cells, int32_t y0, int32_t y1, std::vector<uint32_t>& out) {
+        uint32_t count = 0;
+        uint32_t value = 0;
+        for (int32_t y = y0; y < y1; y ++) {
+            const Cell* row = cells[y];
+            for (int32_t x = 0; x < cells.width(); x ++) {
+                uint32_t next = word(row[x]);
+                if (count && next == value) {
+                    count ++;
+                    continue;
+                }
+                if (count) {
+                    out.push_back(count);
+                    out.push_back(value);
+                }
+                value = next;
+                count = 1;
+            }
+        }
+        if (count) {
+            out.push_back(count);
+            out.push_back(value);
+        }
+    }
+
+    // fill exactly count cells from the runs in [begin, end), false on malformed runs
+    // null cells only checks that the runs fill count cells
+    inline bool decodeBand(const uint8_t* begin, const uint8_t* end, Cell* cells, size_t count) {
+        size_t filled = 0;
+        while (begin + 2 * sizeof(uint32_t) <= end) {
+            uint32_t run;
+            Cell cell;
+            memcpy(&run, begin, sizeof(run));
+            memcpy(&cell, begin + sizeof(run), sizeof(cell));
+            begin += 2 * sizeof(uint32_t);
+            if (run == 0 || run > count - filled) {
+                return false;
+            }
+            if (cells) {
+                std::fill(cells + filled, cells + filled + run, cell);
+            }
+            filled += run;
+        }
+        return begin == end && filled == count;
+    }
+};
+
+// write every cell of a world at the position of file, false on a write error
+inline bool writeSnapshot(FILE* file, const Grid<Cell>& cells, uint64_t tick,
+    SnapshotCompression compression = SnapshotCompression::NONE) {
+    using namespace SnapshotDetail;
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, magic, sizeof(header.magic));
+    header.version = version;
+    header.headerSize = sizeof(SnapshotHeader);
+    header.width = cells.width();
+    header.height = cells.height();
+    header.tick = tick;
+    header.cellSize = sizeof(Cell);
+    header.massShift = Cell::massShift;
+    header.compression = static_cast<uint32_t>(compression);
+    header.bandRows = bandRows;
+
+    int32_t w = cells.width();
+    int32_t h = cells.height();
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> runs;
+    if (compression == SnapshotCompression::RLE) {
+        int32_t bands = (h + bandRows - 1) / bandRows;
+        offsets.reserve(bands + 1);
+        uint64_t table = (bands + 1) * sizeof(uint64_t);
+        for (int32_t band = 0; band < bands; band ++) {
+            offsets.push_back(table + runs.size() * sizeof(uint32_t));
+            encodeBand(cells, band * bandRows, std::min(h, (band + 1) * bandRows), runs);
+        }
+        offsets.push_back(table + runs.size() * sizeof(uint32_t));
+        header.payloadSize = offsets.back();
+    } else {
+        header.payloadSize = static_cast<uint64_t>(w) * h * sizeof(Cell);
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    if (compression == SnapshotCompression::RLE) {
+        written = written && fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), file) == offsets.size();
+        written = written && fwrite(runs.data(), sizeof(uint32_t), runs.size(), file) == runs.size();
+    } else {
+        for (int32_t y = 0; y < h && written; y ++) {
+            written = fwrite(cells[y], sizeof(Cell), w, file) == static_cast<size_t>(w);
+        }
+    }
+    return written;
+}
+
+// write every cell of a world, false if the file can not be written
+inline bool saveSnapshot(const std::string& path, const Grid<Cell>& cells, uint64_t tick,
+    SnapshotCompression compression = SnapshotCompression::NONE) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool written = writeSnapshot(file, cells, tick, compression);
+    return fclose(file) == 0 && written;
+}
+
+inline bool saveSnapshot(const std::string& path, const Simulation& sim,
+    SnapshotCompression compression = SnapshotCompression::NONE) {
+    return saveSnapshot(path, sim.cells(), sim.tickCount(), compression);
+}
+
+// replace sim with the world of the snapshot in [data, data + size), false if it is not one this build can read
+inline bool readSnapshot(const uint8_t* data, size_t size, Simulation& sim) {
+    using namespace SnapshotDetail;
+    if (size < sizeof(SnapshotHeader)) {
+        return false;
+    }
+    SnapshotHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, magic, sizeof(header.magic)) != 0 || header.version != version ||
+        header.headerSize < sizeof(SnapshotHeader) || header.headerSize > size ||
+        header.width <= 0 || header.height <= 0 || header.width > maxSide || header.height > maxSide ||
+        static_cast<uint64_t>(header.width) * header.height > maxCells ||
+        header.cellSize != sizeof(Cell) || header.massShift != Cell::massShift ||
+        header.payloadSize > size - header.headerSize) {
+        return false;
+    }
+
+    int32_t w = header.width;
+    int32_t h = header.height;
+    const uint8_t* payload = data + header.headerSize;
+
+    // the whole payload is checked before the world is allocated
+    int32_t rows = 0;
+    uint64_t bands = 0;
+    std::vector<uint64_t> offsets;
+    if (header.compression == static_cast<uint32_t>(SnapshotCompression::NONE)) {
+        if (header.payloadSize != static_cast<uint64_t>(w) * h * sizeof(Cell)) {
+            return false;
+        }
+    } else if (header.compression == static_cast<uint32_t>(SnapshotCompression::RLE)) {
+        if (header.bandRows == 0) {
+            return false;
+        }
+        rows = static_cast<int32_t>(std::min<uint32_t>(header.bandRows, h));
+        bands = (static_cast<uint64_t>(h) + rows - 1) / rows;
+        uint64_t table = (bands + 1) * sizeof(uint64_t);
+        if (table > header.payloadSize) {
+            return false;
+        }
+        offsets.resize(bands + 1);
+        memcpy(offsets.data(), payload, table);
+        for (uint64_t i = 0; i < bands; i ++) {
+            int32_t y0 = static_cast<int32_t>(i) * rows;
+            int32_t y1 = std::min(h, y0 + rows);
+            if (offsets[i] < table || offsets[i] > offsets[i + 1] || offsets[i + 1] > header.payloadSize ||
+                !decodeBand(payload + offsets[i], payload + offsets[i + 1], nullptr, static_cast<size_t>(w) * (y1 - y0))) {
+                return false;
+            }
+        }
+    } else {
+        return false;
+    }
+
+    Simulation world(w, h);
+    world.setTickCount(header.tick);
+    if (header.compression == static_cast<uint32_t>(SnapshotCompression::NONE)) {
+        world.assignRows(0, h, reinterpret_cast<const Cell*>(payload), w);
+    } else {
+        std::vector<Cell> band(static_cast<size_t>(w) * rows);
+        for (uint64_t i = 0; i < bands; i ++) {
+            int32_t y0 = static_cast<int32_t>(i) * rows;
+            int32_t y1 = std::min(h, y0 + rows);
+            decodeBand(payload + offsets[i], payload + offsets[i + 1], band.data(), static_cast<size_t>(w) * (y1 - y0));
+            world.assignRows(y0, y1, band.data(), w);
+        }
+    }
+
+    sim = std::move(world);
+    return true;
+}
+
+// replace sim with the world of a snapshot, false if the file is missing or not a snapshot this build can read
+inline bool loadSnapshot(const std::string& path, Simulation& sim) {
+    SnapshotDetail::MappedFile file;
+    return file.open(path) && readSnapshot(file.data(), file.size(), sim);
+}
+
+#endif
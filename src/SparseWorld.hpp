@@ -0,0 +1,375 @@
+/**
+ * @file SparseWorld.hpp
+ * @brief Unbounded world of chunks in a hash map, paged to disk, streamed through a simulated window
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#ifndef SPARSEWORLD_HPP
+#define SPARSEWORLD_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Cell.hpp"
+#include "Grid.hpp"
+#include "Simulation.hpp"
+
+/*
+SparseWorld stores a world of unbounded size as chunks of chunkSize x
+chunkSize cells, the chunks of Simulation, in a hash map keyed by chunk
+coordinate. A chunk of nothing but air is not stored at all, so memory
+follows the area that holds material, not its bounding box.
+
+Chunks live in one of two places:
+
+resident    the cells are in memory, kept for up to residentLimit chunks
+paged       the cells are in a slot of the page file, one chunk of 4 KiB
+            per slot; freed slots are reused
+
+Past residentLimit the least recently used resident chunks are written to
+the page file and their memory is released. Reading a paged chunk brings
+it back.
+
+WorldWindow simulates a chunk aligned window of the world in an ordinary
+Simulation and streams chunks between the two as the window moves: the
+chunks it leaves go into the SparseWorld, the chunks it enters come out
+of it. Only the window is simulated, everything outside it is frozen
+until the window reaches it again, and the window's border acts as a
+wall, as the border of any Simulation does.
+*/
+class SparseWorld {
+public:
+    static constexpr int32_t chunkSize = Simulation::chunkSize;
+    static constexpr int32_t chunkCells = chunkSize * chunkSize;
+
+private:
+    struct Entry {
+        // empty while paged
+        std::vector<Cell> cells;
+        int64_t slot;
+        uint64_t lastUse;
+    };
+
+    // fixed size slots of one chunk each
+    class PageFile {
+    private:
+        FILE* file;
+        int64_t slots;
+        std::vector<int64_t> freeSlots;
+
+    public:
+        PageFile() : file(nullptr), slots(0) {}
+
+        PageFile(const PageFile&) = delete;
+        PageFile& operator=(const PageFile&) = delete;
+
+        ~PageFile() {
+            if (file) {
+                fclose(file);
+            }
+        }
+
+        bool open(const std::string& path) {
+            file = fopen(path.c_str(), "w+b");
+            return file != nullptr;
+        }
+
+        bool isOpen() const {
+            return file != nullptr;
+        }
+
+        // the slot the chunk went to, -1 on a write error
+        int64_t write(const Cell* cells) {
+            int64_t slot;
+            if (!freeSlots.empty()) {
+                slot = freeSlots.back();
+                freeSlots.pop_back();
+            } else {
+                slot = slots ++;
+            }
+            if (fseek(file, static_cast<long>(slot * chunkCells * sizeof(Cell)), SEEK_SET) != 0 ||
+                fwrite(cells, sizeof(Cell), chunkCells, file) != static_cast<size_t>(chunkCells)) {
+                freeSlots.push_back(slot);
+                return -1;
+            }
+            return slot;
+        }
+
+        bool read(int64_t slot, Cell* cells) {
+            return fseek(file, static_cast<long>(slot * chunkCells * sizeof(Cell)), SEEK_SET) == 0 &&
+                fread(cells, sizeof(Cell), chunkCells, file) == static_cast<size_t>(chunkCells);
+        }
+
+        void release(int64_t slot) {
+            freeSlots.push_back(slot);
+        }
+
+        int64_t usedSlots() const {
+            return slots - static_cast<int64_t>(freeSlots.size());
+        }
+    };
+
+    std::unordered_map<uint64_t, Entry> chunks;
+    PageFile pages;
+    size_t residentLimit;
+    size_t resident;
+    uint64_t useClock;
+    bool failed;
+
+    static uint64_t key(int32_t cx, int32_t cy) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) | static_cast<uint32_t>(cy);
+    }
+
+    static bool allAir(const Cell* cells) {
+        for (int32_t i = 0; i < chunkCells; i ++) {
+            if (cells[i].type != Simulation::AIR || cells[i].mass != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // page out the least recently used resident chunks until at most limit are left
+    void evict(size_t limit) {
+        if (!pages.isOpen() || resident <= limit) {
+            return;
+        }
+        std::vector<std::pair<uint64_t, uint64_t>> byUse;
+        byUse.reserve(resident);
+        for (const auto& chunk : chunks) {
+            if (!chunk.second.cells.empty()) {
+                byUse.push_back(std::make_pair(chunk.second.lastUse, chunk.first));
+            }
+        }
+        size_t count = resident - limit;
+        std::nth_element(byUse.begin(), byUse.begin() + (count - 1), byUse.end());
+        for (size_t i = 0; i < count; i ++) {
+            Entry& entry = chunks[byUse[i].second];
+            int64_t slot = pages.write(entry.cells.data());
+            if (slot < 0) {
+                failed = true;
+                return;
+            }
+            entry.slot = slot;
+            std::vector<Cell>().swap(entry.cells);
+            resident --;
+        }
+    }
+
+public:
+    // without a page file every chunk stays resident
+    explicit SparseWorld(size_t residentLimit = 4096) : residentLimit(residentLimit), resident(0), useClock(0), failed(false) {}
+
+    SparseWorld(const SparseWorld&) = delete;
+    SparseWorld& operator=(const SparseWorld&) = delete;
+
+    // page cold chunks to path, the file is recreated and only valid while this world exists
+    bool openPageFile(const std::string& path) {
+        return pages.open(path);
+    }
+
+    // resident chunks kept before the coldest are paged out
+    void setResidentLimit(size_t limit) {
+        residentLimit = limit;
+        evict(residentLimit);
+    }
+
+    // true after a chunk could not be written to or read from the page file
+    bool pageError() const {
+        return failed;
+    }
+
+    size_t storedChunks() const {
+        return chunks.size();
+    }
+
+    size_t residentChunks() const {
+        return resident;
+    }
+
+    size_t pagedChunks() const {
+        return chunks.size() - resident;
+    }
+
+    // bytes of cells held in memory
+    size_t residentBytes() const {
+        return resident * chunkCells * sizeof(Cell);
+    }
+
+    // bytes of the page file in use
+    size_t pagedBytes() const {
+        return static_cast<size_t>(pages.usedSlots()) * chunkCells * sizeof(Cell);
+    }
+
+    bool contains(int32_t cx, int32_t cy) const {
+        return chunks.count(key(cx, cy)) != 0;
+    }
+
+    // forget chunk (cx, cy), it is all air from now on
+    void erase(int32_t cx, int32_t cy) {
+        auto found = chunks.find(key(cx, cy));
+        if (found == chunks.end()) {
+            return;
+        }
+        if (found->second.cells.empty()) {
+            pages.release(found->second.slot);
+        } else {
+            resident --;
+        }
+        chunks.erase(found);
+    }
+
+    // copy chunk (cx, cy) into cells, row r at cells + r * stride, and drop it from the store; all air if it was never stored
+    void take(int32_t cx, int32_t cy, Cell* cells, ptrdiff_t stride) {
+        auto found = chunks.find(key(cx, cy));
+        if (found == chunks.end()) {
+            for (int32_t y = 0; y < chunkSize; y ++) {
+                std::fill(cells + y * stride, cells + y * stride + chunkSize, Cell(Simulation::AIR));
+            }
+            return;
+        }
+        Entry& entry = found->second;
+        const Cell* source = entry.cells.data();
+        std::vector<Cell> paged;
+        if (entry.cells.empty()) {
+            paged.resize(chunkCells);
+            if (!pages.read(entry.slot, paged.data())) {
+                failed = true;
+                paged.assign(chunkCells, Cell(Simulation::AIR));
+            }
+            pages.release(entry.slot);
+            source = paged.data();
+        } else {
+            resident --;
+        }
+        for (int32_t y = 0; y < chunkSize; y ++) {
+            memcpy(cells + y * stride, source + y * chunkSize, chunkSize * sizeof(Cell));
+        }
+        chunks.erase(found);
+    }
+
+    // store chunk (cx, cy) from cells, row r at cells + r * stride, all air removes it
+    void put(int32_t cx, int32_t cy, const Cell* cells, ptrdiff_t stride) {
+        std::vector<Cell> packed(chunkCells);
+        for (int32_t y = 0; y < chunkSize; y ++) {
+            memcpy(&packed[y * chunkSize], cells + y * stride, chunkSize * sizeof(Cell));
+        }
+        erase(cx, cy);
+        if (allAir(packed.data())) {
+            return;
+        }
+        Entry& entry = chunks[key(cx, cy)];
+        entry.cells.swap(packed);
+        entry.slot = -1;
+        entry.lastUse = ++ useClock;
+        resident ++;
+        evict(residentLimit);
+    }
+};
+
+class WorldWindow {
+private:
+    SparseWorld& world;
+    Simulation& sim;
+    int32_t cx0;
+    int32_t cy0;
+    int32_t cw;
+    int32_t ch;
+    Grid<Cell> staging;
+
+public:
+    // sim already holds the window at chunk (cx, cy) and replaces what world stored there, its size must be a multiple of the chunk size
+    WorldWindow(SparseWorld& world, Simulation& sim, int32_t cx, int32_t cy)
+        : world(world), sim(sim), cx0(cx), cy0(cy),
+          cw(sim.width() / SparseWorld::chunkSize), ch(sim.height() / SparseWorld::chunkSize),
+          staging(sim.width(), sim.height()) {
+        for (int32_t y = 0; y < ch; y ++) {
+            for (int32_t x = 0; x < cw; x ++) {
+                world.erase(cx0 + x, cy0 + y);
+            }
+        }
+    }
+
+    WorldWindow(const WorldWindow&) = delete;
+    WorldWindow& operator=(const WorldWindow&) = delete;
+
+    // chunk coordinate of the top left chunk
+    int32_t chunkX() const {
+        return cx0;
+    }
+
+    int32_t chunkY() const {
+        return cy0;
+    }
+
+    // world cell coordinate of sim's (0, 0)
+    int64_t originX() const {
+        return static_cast<int64_t>(cx0) * SparseWorld::chunkSize;
+    }
+
+    int64_t originY() const {
+        return static_cast<int64_t>(cy0) * SparseWorld::chunkSize;
+    }
+
+    // move the window so its top left chunk is (cx, cy): chunks left behind are stored, chunks entered are loaded
+    void moveTo(int32_t cx, int32_t cy) {
+        if (cx == cx0 && cy == cy0) {
+            return;
+        }
+        const Grid<Cell>& cells = sim.cells();
+        const int32_t size = SparseWorld::chunkSize;
+        for (int32_t y = 0; y < ch; y ++) {
+            for (int32_t x = 0; x < cw; x ++) {
+                int32_t wx = cx0 + x;
+                int32_t wy = cy0 + y;
+                int32_t nx = wx - cx;
+                int32_t ny = wy - cy;
+                if (nx >= 0 && nx < cw && ny >= 0 && ny < ch) {
+                    // still inside, it only moves within the window
+                    for (int32_t row = 0; row < size; row ++) {
+                        memcpy(staging[ny * size + row] + nx * size, cells[y * size + row] + x * size, size * sizeof(Cell));
+                    }
+                } else {
+                    world.put(wx, wy, cells[y * size] + x * size, cells.stride());
+                }
+            }
+        }
+        int32_t oldX = cx0;
+        int32_t oldY = cy0;
+        cx0 = cx;
+        cy0 = cy;
+        for (int32_t y = 0; y < ch; y ++) {
+            for (int32_t x = 0; x < cw; x ++) {
+                int32_t wx = cx0 + x;
+                int32_t wy = cy0 + y;
+                if (!(wx >= oldX && wx < oldX + cw && wy >= oldY && wy < oldY + ch)) {
+                    world.take(wx, wy, staging[y * size] + x * size, staging.stride());
+                }
+            }
+        }
+        sim.assignRows(0, sim.height(), staging[0], staging.stride());
+    }
+
+    // store the whole window in the world as well, e.g. before saving the world, the window keeps running
+    void flush() {
+        const Grid<Cell>& cells = sim.cells();
+        const int32_t size = SparseWorld::chunkSize;
+        for (int32_t y = 0; y < ch; y ++) {
+            for (int32_t x = 0; x < cw; x ++) {
+                world.put(cx0 + x, cy0 + y, cells[y * size] + x * size, cells.stride());
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,78 @@
+/**
+ * @file SpscQueue.hpp
+ * @brief Bounded lock-free queue with one producer and one consumer thread
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#ifndef SPSCQUEUE_HPP
+#define SPSCQUEUE_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <vector>
+
+/*
+SpscQueue<T> is a ring of a power of two capacity. push() is only called
+by the producer thread and pop() only by the consumer thread, neither of
+them blocks: push() returns false when the ring is full and pop() returns
+false when it is empty.
+
+head and tail count pushes and pops since the start and sit on their own
+cache lines, so the two threads do not invalidate each other's line on
+every operation.
+*/
+template <typename T>
+class SpscQueue {
+private:
+    std::vector<T> items;
+    size_t mask;
+    // next item to pop, written by the consumer
+    alignas(64) std::atomic<size_t> head;
+    // next item to push, written by the producer
+    alignas(64) std::atomic<size_t> tail;
+
+public:
+    explicit SpscQueue(size_t capacity = 1024) : head(0), tail(0) {
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        items.resize(size);
+        mask = size - 1;
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    size_t capacity() const {
+        return items.size();
+    }
+
+    bool push(const T& item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == items.size()) {
+            return false;
+        }
+        items[t & mask] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = items[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+#endif
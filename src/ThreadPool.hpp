@@ -0,0 +1,121 @@
+/**
+ * @file ThreadPool.hpp
+ * @brief Fixed set of worker threads running parallel for loops
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <cstdint>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ThreadPool(n) starts n - 1 workers, the thread calling parallelFor is the
+n-th. parallelFor(count, fn) calls fn(i) for every i in [0, count) and
+returns once all of them are done. Indices are handed out one at a time,
+so which thread runs which index is not fixed; callers that need
+deterministic results must make fn(i) independent of the thread.
+*/
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    std::function<void(int32_t)> job;
+    std::atomic<int32_t> next;
+    int32_t count;
+    int32_t active;
+    uint64_t generation;
+    bool stop;
+
+    void run() {
+        int32_t i;
+        while ((i = next.fetch_add(1, std::memory_order_relaxed)) < count) {
+            job(i);
+        }
+    }
+
+    void work() {
+        uint64_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stop || generation != seen; });
+                if (stop) {
+                    return;
+                }
+                seen = generation;
+            }
+            run();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                active --;
+                if (active == 0) {
+                    done.notify_one();
+                }
+            }
+        }
+    }
+
+public:
+    explicit ThreadPool(int32_t threads = 1) : next(0), count(0), active(0), generation(0), stop(false) {
+        for (int32_t i = 1; i < threads; i ++) {
+            workers.emplace_back(&ThreadPool::work, this);
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int32_t size() const {
+        return static_cast<int32_t>(workers.size()) + 1;
+    }
+
+    void parallelFor(int32_t n, const std::function<void(int32_t)>& fn) {
+        if (workers.empty() || n <= 1) {
+            for (int32_t i = 0; i < n; i ++) {
+                fn(i);
+            }
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = fn;
+            count = n;
+            next.store(0, std::memory_order_relaxed);
+            active = static_cast<int32_t>(workers.size());
+            generation ++;
+        }
+        wake.notify_all();
+        run();
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return active == 0; });
+        job = nullptr;
+    }
+};
+
+#endif
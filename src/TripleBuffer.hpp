@@ -0,0 +1,90 @@
+/**
+ * @file TripleBuffer.hpp
+ * @brief Lock-free hand-off of the latest frame from one thread to another
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#ifndef TRIPLEBUFFER_HPP
+#define TRIPLEBUFFER_HPP
+
+#include <cstdint>
+#include <atomic>
+
+/*
+TripleBuffer<T> passes whole values from one writer thread to one reader
+thread without locks and without either side ever waiting.
+
+The writer fills back() and calls publish(), the reader calls update()
+and, if it returns true, reads front(). Three slots are enough for both
+sides to always own one: the writer owns the back slot, the reader owns
+the front slot and the middle slot holds the newest published value.
+Publishing and taking are a single atomic exchange of the middle slot.
+A reader that is slower than the writer skips values, it never sees a
+half written one.
+*/
+template <typename T>
+class TripleBuffer {
+private:
+    static constexpr uint8_t indexMask = 3;
+    // set while the middle slot holds a value the reader has not taken
+    static constexpr uint8_t freshBit = 4;
+
+    T slots[3];
+    std::atomic<uint8_t> middle;
+    uint8_t backIndex;
+    uint8_t frontIndex;
+
+public:
+    TripleBuffer() : middle(1), backIndex(0), frontIndex(2) {}
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // writer: the slot to fill next
+    T& back() {
+        return slots[backIndex];
+    }
+
+    // writer: which of the three slots back() is, e.g. to keep per slot state
+    int32_t backSlot() const {
+        return backIndex;
+    }
+
+    // writer: hand back() to the reader
+    void publish() {
+        uint8_t old = middle.exchange(backIndex | freshBit, std::memory_order_acq_rel);
+        backIndex = old & indexMask;
+    }
+
+    // writer: true while the last published value was not taken by the reader
+    bool pending() const {
+        return middle.load(std::memory_order_acquire) & freshBit;
+    }
+
+    // reader: switch front() to the newest value, false if nothing was published since the last call
+    bool update() {
+        if (!(middle.load(std::memory_order_relaxed) & freshBit)) {
+            return false;
+        }
+        uint8_t old = middle.exchange(frontIndex, std::memory_order_acq_rel);
+        frontIndex = old & indexMask;
+        return true;
+    }
+
+    // reader: the value taken by the last successful update()
+    const T& front() const {
+        return slots[frontIndex];
+    }
+
+    // any slot, only while no other thread uses the buffer
+    T& slot(int32_t i) {
+        return slots[i];
+    }
+};
+
+#endif
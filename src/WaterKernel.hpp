@@ -0,0 +1,474 @@
+/**
+ * @file WaterKernel.hpp
+ * @brief Water mass model and its vectorized row kernels
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#pragma once
+#ifndef WATERKERNEL_HPP
+#define WATERKERNEL_HPP
+
+#include <cstdint>
+#include <algorithm>
+
+#include "Cell.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define WATER_KERNEL_X86 1
+#include <immintrin.h>
+#else
+#define WATER_KERNEL_X86 0
+#endif
+
+/*
+The vectorized water pass splits Simulation::update_water over one row into
+two steps on rows of packed cells (see Cell.hpp):
+
+flows   for every cell, the mass it sends down, right, left and up
+apply   buffer[y][x] = ((buffer[y][x] + right[x - 1]) - down[x]
+            - right[x] - left[x] - up[x]) + left[x + 1]
+        buffer[y + 1][x] += down[x], buffer[y - 1][x] += up[x]
+
+Flows are worked out in float from the fixed-point masses, exactly as
+update_water does, and rounded toward zero to whole mass units. No FMA
+contraction is allowed in the kernels, so every lane produces the same
+units as the scalar rule. apply is then integer arithmetic in the order
+of the serial sweep, saturating like Cell::addUnits(), so the kernels and
+update_water leave bit-identical worlds.
+*/
+namespace Water {
+    constexpr float maxMass = 1.0;
+    constexpr float maxCompress = 0.02;
+    constexpr float minMass = 0.001;
+    constexpr float minFlow = 0.01;
+    constexpr float maxSpeed = 1.0;
+
+    // a mass is above minMass exactly when its units are above minUnits
+    constexpr int32_t minUnits = static_cast<int32_t>(minMass * Cell::massScale);
+
+    inline float calcFlow(float totalMass) {
+        if (totalMass <= 1.0) {
+            return 1;
+        } else if (totalMass < 2 * maxMass + maxCompress) {
+            return (maxMass * maxMass + totalMass * maxCompress) / (maxMass + maxCompress);
+        } else {
+            return (totalMass + maxCompress) / 2;
+        }
+    }
+
+    inline float constrain(float x, float min, float max) {
+        if (x < min) {
+            return min;
+        } else if (x > max) {
+            return max;
+        } else {
+            return x;
+        }
+    }
+
+    enum Kernel {
+        SCALAR,
+        SSE2,
+        AVX2
+    };
+
+    inline const char* kernelName(Kernel kernel) {
+        switch (kernel) {
+            case SCALAR: return "scalar";
+            case SSE2: return "sse2";
+            case AVX2: return "avx2";
+        }
+        return "";
+    }
+
+    inline bool kernelSupported(Kernel kernel) {
+        switch (kernel) {
+            case SCALAR: {
+                return true;
+            }
+#if WATER_KERNEL_X86
+            case SSE2: {
+                return __builtin_cpu_supports("sse2");
+            }
+            case AVX2: {
+                return __builtin_cpu_supports("avx2");
+            }
+#endif
+            default: {
+                return false;
+            }
+        }
+    }
+
+    inline Kernel bestKernel() {
+        if (kernelSupported(AVX2)) {
+            return AVX2;
+        } else if (kernelSupported(SSE2)) {
+            return SSE2;
+        }
+        return SCALAR;
+    }
+
+    // one row of the water pass, x - 1 and x + 1 must be readable for every processed x
+    struct Row {
+        // the rows above and below, and the row before and after its sand moved
+        const Cell* above;
+        const Cell* cells;
+        const Cell* swept;
+        const Cell* below;
+        // flows out of every cell, in mass units
+        int32_t* down;
+        int32_t* right;
+        int32_t* left;
+        int32_t* up;
+        uint8_t air;
+        uint8_t water;
+    };
+
+    inline bool isOpen(const Row& row, const Cell& cell) {
+        return cell.type == row.air || cell.type == row.water;
+    }
+
+    inline void flowsLane(const Row& row, int32_t x) {
+        int32_t down = 0;
+        int32_t right = 0;
+        int32_t left = 0;
+        int32_t up = 0;
+        if (row.cells[x].type == row.water && row.cells[x].mass > 0) {
+            float cellMass = row.cells[x].massValue();
+            float remainingMass = cellMass;
+            float flow;
+
+            if (isOpen(row, row.below[x])) {
+                float massBelow = row.below[x].massValue();
+                flow = calcFlow(remainingMass + massBelow) - massBelow;
+                if (flow > minFlow) {
+                    flow *= 0.5;
+                }
+                down = Cell::flowUnits(constrain(flow, 0, std::min(maxSpeed, remainingMass)));
+                remainingMass -= Cell::toMass(down);
+            }
+            if (remainingMass > 0.0 && isOpen(row, row.cells[x + 1])) {
+                flow = (cellMass - row.cells[x + 1].massValue()) / 4.0;
+                if (flow > minFlow) {
+                    flow *= 0.5;
+                }
+                right = Cell::flowUnits(constrain(flow, 0, remainingMass));
+                remainingMass -= Cell::toMass(right);
+            }
+            if (remainingMass > 0.0 && isOpen(row, row.swept[x - 1])) {
+                flow = (cellMass - row.cells[x - 1].massValue()) / 4.0;
+                if (flow > minFlow) {
+                    flow *= 0.5;
+                }
+                left = Cell::flowUnits(constrain(flow, 0, remainingMass));
+                remainingMass -= Cell::toMass(left);
+            }
+            if (remainingMass > 0.0 && isOpen(row, row.above[x])) {
+                flow = remainingMass - calcFlow(remainingMass + row.above[x].massValue());
+                if (flow > minFlow) {
+                    flow *= 0.5;
+                }
+                up = Cell::flowUnits(constrain(flow, 0, std::min(maxSpeed, remainingMass)));
+            }
+        }
+        row.down[x] = down;
+        row.right[x] = right;
+        row.left[x] = left;
+        row.up[x] = up;
+    }
+
+    inline void applyLane(const Row& row, Cell* above, Cell* cells, Cell* below, int32_t x) {
+        uint16_t units = Cell::addUnits(cells[x].mass, row.right[x - 1]);
+        units = Cell::subUnits(units, row.down[x]);
+        units = Cell::subUnits(units, row.right[x]);
+        units = Cell::subUnits(units, row.left[x]);
+        units = Cell::subUnits(units, row.up[x]);
+        cells[x].mass = Cell::addUnits(units, row.left[x + 1]);
+        below[x].mass = Cell::addUnits(below[x].mass, row.down[x]);
+        above[x].mass = Cell::addUnits(above[x].mass, row.up[x]);
+    }
+
+    inline void flowsScalar(const Row& row, int32_t x0, int32_t x1) {
+        for (int32_t x = x0; x < x1; x ++) {
+            flowsLane(row, x);
+        }
+    }
+
+    inline void applyScalar(const Row& row, Cell* above, Cell* cells, Cell* below, int32_t x0, int32_t x1) {
+        for (int32_t x = x0; x < x1; x ++) {
+            applyLane(row, above, cells, below, x);
+        }
+    }
+
+#if WATER_KERNEL_X86
+    namespace SSE {
+        inline __m128 select(__m128 mask, __m128 a, __m128 b) {
+            return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+        }
+
+        inline __m128i load(const void* p) {
+            return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        }
+
+        inline __m128 isOpen(const Cell* cells, const Row& row) {
+            __m128i t = _mm_and_si128(load(cells), _mm_set1_epi32(0xff));
+            __m128i open = _mm_or_si128(_mm_cmpeq_epi32(t, _mm_set1_epi32(row.air)), _mm_cmpeq_epi32(t, _mm_set1_epi32(row.water)));
+            return _mm_castsi128_ps(open);
+        }
+
+        inline __m128 toMass(__m128i units) {
+            return _mm_mul_ps(_mm_cvtepi32_ps(units), _mm_set1_ps(Cell::massUnit));
+        }
+
+        // the masses of four packed cells
+        inline __m128 massOf(const Cell* cells) {
+            return toMass(_mm_srli_epi32(load(cells), 16));
+        }
+
+        inline __m128i flowUnits(__m128 flow) {
+            return _mm_cvttps_epi32(_mm_mul_ps(flow, _mm_set1_ps(Cell::massScale)));
+        }
+
+        // a flow moved into the mass half of every word
+        inline __m128i shifted(const int32_t* flow) {
+            return _mm_slli_epi32(load(flow), 16);
+        }
+
+        inline __m128 calcFlow(__m128 total) {
+            const __m128 one = _mm_set1_ps(1.0f);
+            __m128 compressed = _mm_div_ps(_mm_add_ps(_mm_set1_ps(maxMass * maxMass), _mm_mul_ps(total, _mm_set1_ps(maxCompress))), _mm_set1_ps(maxMass + maxCompress));
+            __m128 overflow = _mm_div_ps(_mm_add_ps(total, _mm_set1_ps(maxCompress)), _mm_set1_ps(2.0f));
+            __m128 result = select(_mm_cmplt_ps(total, _mm_set1_ps(2 * maxMass + maxCompress)), compressed, overflow);
+            return select(_mm_cmple_ps(total, one), one, result);
+        }
+
+        inline __m128 halve(__m128 flow) {
+            return select(_mm_cmpgt_ps(flow, _mm_set1_ps(minFlow)), _mm_mul_ps(flow, _mm_set1_ps(0.5f)), flow);
+        }
+
+        inline __m128 constrain(__m128 flow, __m128 max) {
+            __m128 result = select(_mm_cmpgt_ps(flow, max), max, flow);
+            return _mm_andnot_ps(_mm_cmplt_ps(flow, _mm_setzero_ps()), result);
+        }
+    };
+
+    inline void flowsSSE2(const Row& row, int32_t x0, int32_t x1) {
+        using namespace SSE;
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 speed = _mm_set1_ps(maxSpeed);
+        const __m128 quarter = _mm_set1_ps(0.25f);
+        int32_t x = x0;
+        for (; x + 4 <= x1; x += 4) {
+            __m128i cells = load(row.cells + x);
+            __m128i type = _mm_and_si128(cells, _mm_set1_epi32(0xff));
+            __m128 cellMass = toMass(_mm_srli_epi32(cells, 16));
+            __m128 active = _mm_and_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(type, _mm_set1_epi32(row.water))), _mm_cmpgt_ps(cellMass, zero));
+            __m128 remainingMass = cellMass;
+
+            // below
+            __m128 massBelow = massOf(row.below + x);
+            __m128 flow = _mm_sub_ps(calcFlow(_mm_add_ps(remainingMass, massBelow)), massBelow);
+            flow = constrain(halve(flow), _mm_min_ps(speed, remainingMass));
+            __m128i down = flowUnits(_mm_and_ps(_mm_and_ps(active, isOpen(row.below + x, row)), flow));
+            remainingMass = _mm_sub_ps(remainingMass, toMass(down));
+
+            // right
+            flow = _mm_mul_ps(_mm_sub_ps(cellMass, massOf(row.cells + x + 1)), quarter);
+            flow = constrain(halve(flow), remainingMass);
+            __m128i right = flowUnits(_mm_and_ps(_mm_and_ps(_mm_and_ps(active, _mm_cmpgt_ps(remainingMass, zero)), isOpen(row.cells + x + 1, row)), flow));
+            remainingMass = _mm_sub_ps(remainingMass, toMass(right));
+
+            // left
+            flow = _mm_mul_ps(_mm_sub_ps(cellMass, massOf(row.cells + x - 1)), quarter);
+            flow = constrain(halve(flow), remainingMass);
+            __m128i left = flowUnits(_mm_and_ps(_mm_and_ps(_mm_and_ps(active, _mm_cmpgt_ps(remainingMass, zero)), isOpen(row.swept + x - 1, row)), flow));
+            remainingMass = _mm_sub_ps(remainingMass, toMass(left));
+
+            // up
+            flow = _mm_sub_ps(remainingMass, calcFlow(_mm_add_ps(remainingMass, massOf(row.above + x))));
+            flow = constrain(halve(flow), _mm_min_ps(speed, remainingMass));
+            __m128i up = flowUnits(_mm_and_ps(_mm_and_ps(_mm_and_ps(active, _mm_cmpgt_ps(remainingMass, zero)), isOpen(row.above + x, row)), flow));
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(row.down + x), down);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(row.right + x), right);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(row.left + x), left);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(row.up + x), up);
+        }
+        flowsScalar(row, x, x1);
+    }
+
+    // the mass is the high half of every word, unsigned saturating 16-bit math leaves type and flags alone
+    inline void applySSE2(const Row& row, Cell* above, Cell* cells, Cell* below, int32_t x0, int32_t x1) {
+        using namespace SSE;
+        int32_t x = x0;
+        for (; x + 4 <= x1; x += 4) {
+            __m128i down = shifted(row.down + x);
+            __m128i up = shifted(row.up + x);
+            __m128i value = _mm_adds_epu16(load(cells + x), shifted(row.right + x - 1));
+            value = _mm_subs_epu16(value, down);
+            value = _mm_subs_epu16(value, shifted(row.right + x));
+            value = _mm_subs_epu16(value, shifted(row.left + x));
+            value = _mm_subs_epu16(value, up);
+            value = _mm_adds_epu16(value, shifted(row.left + x + 1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(cells + x), value);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(below + x), _mm_adds_epu16(load(below + x), down));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(above + x), _mm_adds_epu16(load(above + x), up));
+        }
+        applyScalar(row, above, cells, below, x, x1);
+    }
+
+    namespace AVX {
+        __attribute__((target("avx2"))) inline __m256i load(const void* p) {
+            return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        }
+
+        __attribute__((target("avx2"))) inline __m256 isOpen(const Cell* cells, const Row& row) {
+            __m256i t = _mm256_and_si256(load(cells), _mm256_set1_epi32(0xff));
+            __m256i open = _mm256_or_si256(_mm256_cmpeq_epi32(t, _mm256_set1_epi32(row.air)), _mm256_cmpeq_epi32(t, _mm256_set1_epi32(row.water)));
+            return _mm256_castsi256_ps(open);
+        }
+
+        __attribute__((target("avx2"))) inline __m256 toMass(__m256i units) {
+            return _mm256_mul_ps(_mm256_cvtepi32_ps(units), _mm256_set1_ps(Cell::massUnit));
+        }
+
+        __attribute__((target("avx2"))) inline __m256 massOf(const Cell* cells) {
+            return toMass(_mm256_srli_epi32(load(cells), 16));
+        }
+
+        __attribute__((target("avx2"))) inline __m256i flowUnits(__m256 flow) {
+            return _mm256_cvttps_epi32(_mm256_mul_ps(flow, _mm256_set1_ps(Cell::massScale)));
+        }
+
+        __attribute__((target("avx2"))) inline __m256i shifted(const int32_t* flow) {
+            return _mm256_slli_epi32(load(flow), 16);
+        }
+
+        __attribute__((target("avx2"))) inline __m256 calcFlow(__m256 total) {
+            const __m256 one = _mm256_set1_ps(1.0f);
+            __m256 compressed = _mm256_div_ps(_mm256_add_ps(_mm256_set1_ps(maxMass * maxMass), _mm256_mul_ps(total, _mm256_set1_ps(maxCompress))), _mm256_set1_ps(maxMass + maxCompress));
+            __m256 overflow = _mm256_div_ps(_mm256_add_ps(total, _mm256_set1_ps(maxCompress)), _mm256_set1_ps(2.0f));
+            __m256 result = _mm256_blendv_ps(overflow, compressed, _mm256_cmp_ps(total, _mm256_set1_ps(2 * maxMass + maxCompress), _CMP_LT_OQ));
+            return _mm256_blendv_ps(result, one, _mm256_cmp_ps(total, one, _CMP_LE_OQ));
+        }
+
+        __attribute__((target("avx2"))) inline __m256 halve(__m256 flow) {
+            return _mm256_blendv_ps(flow, _mm256_mul_ps(flow, _mm256_set1_ps(0.5f)), _mm256_cmp_ps(flow, _mm256_set1_ps(minFlow), _CMP_GT_OQ));
+        }
+
+        __attribute__((target("avx2"))) inline __m256 constrain(__m256 flow, __m256 max) {
+            __m256 result = _mm256_blendv_ps(flow, max, _mm256_cmp_ps(flow, max, _CMP_GT_OQ));
+            return _mm256_andnot_ps(_mm256_cmp_ps(flow, _mm256_setzero_ps(), _CMP_LT_OQ), result);
+        }
+    };
+
+    __attribute__((target("avx2"))) inline void flowsAVX2(const Row& row, int32_t x0, int32_t x1) {
+        using namespace AVX;
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 speed = _mm256_set1_ps(maxSpeed);
+        const __m256 quarter = _mm256_set1_ps(0.25f);
+        int32_t x = x0;
+        for (; x + 8 <= x1; x += 8) {
+            __m256i cells = load(row.cells + x);
+            __m256i type = _mm256_and_si256(cells, _mm256_set1_epi32(0xff));
+            __m256 cellMass = toMass(_mm256_srli_epi32(cells, 16));
+            __m256 active = _mm256_and_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(type, _mm256_set1_epi32(row.water))), _mm256_cmp_ps(cellMass, zero, _CMP_GT_OQ));
+            __m256 remainingMass = cellMass;
+
+            // below
+            __m256 massBelow = massOf(row.below + x);
+            __m256 flow = _mm256_sub_ps(calcFlow(_mm256_add_ps(remainingMass, massBelow)), massBelow);
+            flow = constrain(halve(flow), _mm256_min_ps(speed, remainingMass));
+            __m256i down = flowUnits(_mm256_and_ps(_mm256_and_ps(active, isOpen(row.below + x, row)), flow));
+            remainingMass = _mm256_sub_ps(remainingMass, toMass(down));
+
+            // right
+            flow = _mm256_mul_ps(_mm256_sub_ps(cellMass, massOf(row.cells + x + 1)), quarter);
+            flow = constrain(halve(flow), remainingMass);
+            __m256i right = flowUnits(_mm256_and_ps(_mm256_and_ps(_mm256_and_ps(active, _mm256_cmp_ps(remainingMass, zero, _CMP_GT_OQ)), isOpen(row.cells + x + 1, row)), flow));
+            remainingMass = _mm256_sub_ps(remainingMass, toMass(right));
+
+            // left
+            flow = _mm256_mul_ps(_mm256_sub_ps(cellMass, massOf(row.cells + x - 1)), quarter);
+            flow = constrain(halve(flow), remainingMass);
+            __m256i left = flowUnits(_mm256_and_ps(_mm256_and_ps(_mm256_and_ps(active, _mm256_cmp_ps(remainingMass, zero, _CMP_GT_OQ)), isOpen(row.swept + x - 1, row)), flow));
+            remainingMass = _mm256_sub_ps(remainingMass, toMass(left));
+
+            // up
+            flow = _mm256_sub_ps(remainingMass, calcFlow(_mm256_add_ps(remainingMass, massOf(row.above + x))));
+            flow = constrain(halve(flow), _mm256_min_ps(speed, remainingMass));
+            __m256i up = flowUnits(_mm256_and_ps(_mm256_and_ps(_mm256_and_ps(active, _mm256_cmp_ps(remainingMass, zero, _CMP_GT_OQ)), isOpen(row.above + x, row)), flow));
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(row.down + x), down);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(row.right + x), right);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(row.left + x), left);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(row.up + x), up);
+        }
+        flowsScalar(row, x, x1);
+    }
+
+    __attribute__((target("avx2"))) inline void applyAVX2(const Row& row, Cell* above, Cell* cells, Cell* below, int32_t x0, int32_t x1) {
+        using namespace AVX;
+        int32_t x = x0;
+        for (; x + 8 <= x1; x += 8) {
+            __m256i down = shifted(row.down + x);
+            __m256i up = shifted(row.up + x);
+            __m256i value = _mm256_adds_epu16(load(cells + x), shifted(row.right + x - 1));
+            value = _mm256_subs_epu16(value, down);
+            value = _mm256_subs_epu16(value, shifted(row.right + x));
+            value = _mm256_subs_epu16(value, shifted(row.left + x));
+            value = _mm256_subs_epu16(value, up);
+            value = _mm256_adds_epu16(value, shifted(row.left + x + 1));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(cells + x), value);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(below + x), _mm256_adds_epu16(load(below + x), down));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(above + x), _mm256_adds_epu16(load(above + x), up));
+        }
+        applyScalar(row, above, cells, below, x, x1);
+    }
+#endif
+
+    inline void flows(Kernel kernel, const Row& row, int32_t x0, int32_t x1) {
+        switch (kernel) {
+#if WATER_KERNEL_X86
+            case SSE2: {
+                flowsSSE2(row, x0, x1);
+                return;
+            }
+            case AVX2: {
+                flowsAVX2(row, x0, x1);
+                return;
+            }
+#endif
+            default: {
+                flowsScalar(row, x0, x1);
+                return;
+            }
+        }
+    }
+
+    inline void apply(Kernel kernel, const Row& row, Cell* above, Cell* cells, Cell* below, int32_t x0, int32_t x1) {
+        switch (kernel) {
+#if WATER_KERNEL_X86
+            case SSE2: {
+                applySSE2(row, above, cells, below, x0, x1);
+                return;
+            }
+            case AVX2: {
+                applyAVX2(row, above, cells, below, x0, x1);
+                return;
+            }
+#endif
+            default: {
+                applyScalar(row, above, cells, below, x0, x1);
+                return;
+            }
+        }
+    }
+};
+
+#endif
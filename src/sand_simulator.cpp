@@ -1,269 +1,691 @@
 #define DEBUG_ENABLED 1
 #include "R2DEngine.hpp"
+#include "Brush.hpp"
+#include "Camera.hpp"
+#include "Simulation.hpp"
+#include "GpuSimulation.hpp"
+#include "Materials.hpp"
+#include "Replay.hpp"
+#include "SimulationThread.hpp"
+#include "Snapshot.hpp"
+#include "SparseWorld.hpp"
 
 class App : public R2DEngine {
     GLint uTime_loc;
 
-    double time;
-    bool tick;
-
-    enum CellID {
-        AIR,
-        WALL,
-        SAND,
-        WATER
-    };
-    struct Particle {
-        CellID id;
-        Color color;
-    };
-    std::vector<std::vector<CellID>> map;
-    std::vector<std::vector<CellID>> mapBuffer;
-
-    // water
-    std::vector<std::vector<float>> mass;
-    std::vector<std::vector<float>> massBuffer;
-    const float maxMass = 1.0;
-    const float maxCompress = 0.02;
-    const float minMass = 0.001;
-    const float minFlow = 0.01;
-    const float maxSpeed = 1.0;
-
-    void update_wall(int x, int y) {
-        mapBuffer[y][x] = WALL;
-    }
-
-    void update_sand(int x, int y) {
-        if (map[y + 1][x] != SAND && map[y + 1][x] != WALL) {
-            mapBuffer[y + 1][x] = SAND;
-            map[y][x] = map[y + 1][x];
-        } else if (map[y + 1][x - 1] != SAND && map[y + 1][x - 1] != WALL) {
-            mapBuffer[y + 1][x - 1] = SAND;
-            map[y][x] = map[y + 1][x - 1];
-        } else if (map[y + 1][x + 1] != SAND && map[y + 1][x + 1] != WALL) {
-            mapBuffer[y + 1][x + 1] = SAND;
-            map[y][x] = map[y + 1][x + 1];
-        } else {
-            mapBuffer[y][x] = SAND;
+
+    typedef Simulation::CellID CellID;
+    // color of every CellID
+    uint32_t palette[Materials::COUNT];
+    // brush of the left button, the number keys pick the material by ID, [ and ] the radius, Tab the shape
+    Brush brush;
+    bool brushHeld = false;
+    // a stroke continues from the cell painted last frame while a button stays down
+    bool stroking = false;
+    int32_t strokeX = 0;
+    int32_t strokeY = 0;
+    std::vector<BrushSpan> spans;
+    // the world is built in sim, then handed to simThread, or uploaded to gpu
+    Simulation sim;
+    std::unique_ptr<SimulationThread> simThread;
+    bool useGpu;
+    std::unique_ptr<GpuSimulation> gpu;
+    // F5 writes the world here
+    std::string savePath;
+    bool saveHeld = false;
+    SimulationThread::SnapshotState lastSnapshot = SimulationThread::SNAPSHOT_IDLE;
+    // edits are recorded to recordPath, or the edits of replaying are played back instead of the mouse
+    std::string recordPath;
+    Recording recording;
+    std::unique_ptr<Recording> replaying;
+    Replayer replayer;
+    SimulationThread::ReplayState lastReplay = SimulationThread::REPLAY_NONE;
+    // with a page file the map is a window on an unbounded world, W / A / S / D move it a chunk
+    std::string pagePath;
+    std::unique_ptr<SparseWorld> sparseWorld;
+    std::unique_ptr<WorldWindow> worldWindow;
+    bool moveHeld = false;
+    // the frame buffer is a viewport of the world, arrow keys pan, + and - zoom, Home resets
+    Camera camera;
+    Camera drawnCamera;
+    WorldView worldView;
+    bool zoomHeld = false;
+    // with material rendering the worker sends cell types and masses, the fragment shader colors them
+    bool materialRender = false;
+    BasicWorldView<uint8_t> idView;
+    BasicWorldView<uint8_t> massView;
+    std::vector<uint8_t> viewIds;
+    std::vector<uint8_t> viewMasses;
+    GLuint cellTexture = 0;
+    GLuint massTexture = 0;
+    std::vector<Simulation::Rect> redrawn;
+    Simulation::WaterModel waterModel = Simulation::WaterModel::MASS;
+    // more than 1 ticks the CPU simulation with the banded sweep, its commit colors the frame in bands
+    int32_t simThreads = 1;
+
+public:
+    uint32_t mapWidth = 80 * 2;
+    uint32_t mapHeight = 60 * 2;
+    // size of the frame buffer, drawing costs this many pixels however large the world is
+    uint32_t viewWidth = 0;
+    uint32_t viewHeight = 0;
+
+    // world is a loaded snapshot, or empty for the default walled world
+    App(bool useGpu = false, Simulation&& world = Simulation(), const std::string& savePath = "world.snap")
+        : sim(std::move(world)), useGpu(useGpu), savePath(savePath) {
+        if (sim.width() > 0) {
+            mapWidth = sim.width();
+            mapHeight = sim.height();
+        }
+        if (useGpu) {
+            // compute shaders
+            glVersionMajor = 4;
+            glVersionMinor = 3;
         }
     }
 
-    float calcFlow(float totalMass) {
-        if (totalMass <= 1.0) {
-            return 1;
-        } else if (totalMass < 2 * maxMass + maxCompress) {
-            return (maxMass * maxMass + totalMass * maxCompress) / (maxMass + maxCompress);
-        } else {
-            return (totalMass + maxCompress) / 2;
-        }
+    // start with the profiler overlay shown, F3 toggles it
+    void showProfiler(bool shown) {
+        showProfile = shown;
     }
 
-    inline float constrain(float x, float min, float max) {
-        if (x < min) {
-            return min;
-        } else if (x > max) {
-            return max;
-        } else {
-            return x;
+    // record every edit of this run to path, written when the app closes
+    void record(const std::string& path) {
+        recordPath = path;
+    }
+
+    // play back the edits of a recording, the world is the one the recording starts from
+    void replay(std::unique_ptr<Recording>&& played) {
+        replaying = std::move(played);
+        replayer = Replayer(replaying.get());
+    }
+
+    // stream the world outside the map through a page file at path, the map is grown to whole chunks
+    void stream(const std::string& path) {
+        pagePath = path;
+        mapWidth = (mapWidth + Simulation::chunkSize - 1) / Simulation::chunkSize * Simulation::chunkSize;
+        mapHeight = (mapHeight + Simulation::chunkSize - 1) / Simulation::chunkSize * Simulation::chunkSize;
+    }
+
+    // frame buffer size, 0 fits the map up to maxWidth x maxHeight; the GPU colors the whole map into it
+    void view(uint32_t width, uint32_t height, uint32_t maxWidth = 1280, uint32_t maxHeight = 720) {
+        if (useGpu) {
+            viewWidth = mapWidth;
+            viewHeight = mapHeight;
+            return;
         }
+        viewWidth = width > 0 ? width : std::min(mapWidth, maxWidth);
+        viewHeight = height > 0 ? height : std::min(mapHeight, maxHeight);
     }
 
-    void update_water(int x, int y) {
-        float flow = 0.0;
-        float remainingMass = mass[y][x];
-        if (remainingMass <= 0.0) return;
+    // how the CPU simulation moves water, the GPU only has the mass model
+    void useWaterModel(Simulation::WaterModel model) {
+        waterModel = model;
+    }
+
+    // worker threads of the CPU simulation, recordings store the banded mode they give
+    void useThreads(int32_t threads) {
+        simThreads = std::max(threads, 1);
+    }
 
-        // below
-        if (map[y + 1][x] == AIR || map[y + 1][x] == WATER) {
-            flow = calcFlow(remainingMass + mass[y + 1][x]) - mass[y + 1][x];
-            if (flow > minFlow) {
-                flow *= 0.5;
+    // color on the GPU from one byte per cell, the shaders passed to init() must be the material ones
+    void renderMaterials(bool on) {
+        materialRender = on && !useGpu;
+    }
+
+    void resetCamera() {
+        camera = Camera(viewWidth, viewHeight);
+        camera.lookAt(mapWidth * 0.5, mapHeight * 0.5);
+    }
+
+    // the cell under the mouse
+    int32_t mouseCellX() const {
+        return static_cast<int32_t>(std::floor(camera.worldX(mousePosX + 0.5)));
+    }
+
+    int32_t mouseCellY() const {
+        return static_cast<int32_t>(std::floor(camera.worldY(mousePosY + 0.5)));
+    }
+
+    // drag stroke from (x0, y0) to (x1, y1), all of a frame's painting goes out as this one edit
+    void paint(int32_t x0, int32_t y0, int32_t x1, int32_t y1, const Brush& stroke) {
+        if (gpu) {
+            spans.clear();
+            rasterizeStroke(stroke, x0, y0, x1, y1, mapWidth, mapHeight, spans);
+            for (const BrushSpan& span : spans) {
+                gpu->fillRow(span.x, span.y, span.length, stroke.material, stroke.mass);
+                if (recording.recording()) {
+                    for (int32_t x = span.x; x < span.x + span.length; x ++) {
+                        recording.record(gpu->tickCount(), x, span.y, stroke.material, stroke.mass);
+                    }
+                }
             }
-            flow = constrain(flow, 0, std::min(maxSpeed, remainingMass));
-            massBuffer[y][x] -= flow;
-            massBuffer[y + 1][x] += flow;
-            remainingMass -= flow;
+        } else if (simThread) {
+            SimulationThread::Event event;
+            event.x0 = x0;
+            event.y0 = y0;
+            event.x1 = x1;
+            event.y1 = y1;
+            event.brush = stroke;
+            simThread->post(event);
         }
+    }
 
-        if (remainingMass <= 0.0) return;
+    void pickBrush() {
+        for (int32_t id = 1; id < Materials::COUNT && id <= 9; id ++) {
+            if (getKeyState(GLFW_KEY_0 + id) == PRESS && brush.material != id) {
+                brush.material = static_cast<CellID>(id);
+                DEBUG_MSG((std::string("drawing ") + Materials::name(brush.material)).c_str());
+            }
+        }
+        int32_t grow = (getKeyState(GLFW_KEY_RIGHT_BRACKET) != RELEASE) - (getKeyState(GLFW_KEY_LEFT_BRACKET) != RELEASE);
+        bool shapeDown = getKeyState(GLFW_KEY_TAB) != RELEASE;
+        bool brushDown = grow != 0 || shapeDown;
+        if (brushDown && !brushHeld) {
+            brush.radius = std::min(std::max(brush.radius + grow, 0), Brush::maxRadius);
+            if (shapeDown) {
+                brush.shape = brush.shape == BrushShape::CIRCLE ? BrushShape::SQUARE : BrushShape::CIRCLE;
+            }
+            DEBUG_MSG(("brush radius " + std::to_string(brush.radius) +
+                (brush.shape == BrushShape::CIRCLE ? ", circle" : ", square")).c_str());
+        }
+        brushHeld = brushDown;
+    }
 
-        // right
-        if (map[y][x + 1] == AIR || map[y][x + 1] == WATER) {
-            flow = (mass[y][x] - mass[y][x + 1]) / 4.0;
-            if (flow > minFlow) {
-                flow *= 0.5;
+    bool onCreate() override {
+        windowTitle = "Sand Simulator";
+        // only the regions the simulation reports as changed are redrawn
+        clearFrame = false;
+        if (materialRender && glGetUniformLocation(shader, "cells") < 0) {
+            // the default shaders of a missing file would draw the empty overlay only
+            DEBUG_ERROR("--render material needs shaders/material.fsh");
+            return false;
+        }
+        if (sim.width() == 0 && !pagePath.empty()) {
+            // the edge of the map is only the edge of the window
+            sim = Simulation(mapWidth, mapHeight);
+        } else if (sim.width() == 0) {
+            sim = Simulation(mapWidth, mapHeight);
+            for (int y = 0; y < mapHeight; y ++) {
+                for (int x = 0; x < mapWidth; x ++) {
+                    if (y == mapHeight - 1 || x == 0 || x == mapWidth - 1) {
+                        sim.set(x, y, Simulation::WALL);
+                    }
+                }
             }
-            flow = constrain(flow, 0, remainingMass);
+        }
+        // the rules were tuned for 250 ticks per second
+        fixedStep = 1.0 / 250.0;
+        maxSubSteps = 8;
 
-            massBuffer[y][x] -= flow;
-            massBuffer[y][x + 1] += flow;
-            remainingMass -= flow;
+        Materials::palette(palette);
+
+        uTime_loc = glGetUniformLocation(shader, "uTime");
+        resetCamera();
+        if (materialRender) {
+            createMaterialTextures();
         }
 
-        if (remainingMass <= 0.0) return;
+        sim.setWaterModel(waterModel);
+        sim.setThreads(useGpu ? 1 : simThreads);
+        if (replaying) {
+            // the state hash only matches in the update mode the run was recorded with, any banded thread count gives the same
+            ReplayMode mode = replaying->mode();
+            sim.setInPlace(mode == ReplayMode::IN_PLACE || mode == ReplayMode::IN_PLACE_BANDED);
+            bool banded = mode == ReplayMode::BANDED || mode == ReplayMode::IN_PLACE_BANDED;
+            sim.setThreads(banded ? std::max(simThreads, 2) : 1);
+        }
+        if (!recordPath.empty()) {
+            recording.begin(sim.cells(), sim.tickCount(), replayMode(sim), sim.waterModel());
+        }
 
-        // left
-        if (map[y][x - 1] == AIR || map[y][x - 1] == WATER) {
-            flow = (mass[y][x] - mass[y][x - 1]) / 4.0;
-            if (flow > minFlow) {
-                flow *= 0.5;
+        if (useGpu) {
+            gpu.reset(new GpuSimulation());
+            if (gpu->create(mapWidth, mapHeight)) {
+                gpu->upload(sim);
+                DEBUG_MSG("simulating on the GPU");
+            } else {
+                DEBUG_ERROR(gpu->error().c_str());
+                gpu.reset();
             }
-            flow = constrain(flow, 0, remainingMass);
-
-            massBuffer[y][x] -= flow;
-            massBuffer[y][x - 1] += flow;
-            remainingMass -= flow;
+        }
+        if (!gpu) {
+            // ticks on its own thread, the engine only uploads the frames it publishes
+            SimulationThread::FrameFormat format = materialRender ? SimulationThread::FrameFormat::MATERIAL : SimulationThread::FrameFormat::RGBA;
+            simThread.reset(new SimulationThread(std::move(sim), fixedStep, maxSubSteps, palette, Materials::COUNT, format));
+            if (recording.recording()) {
+                simThread->record(&recording);
+            }
+            if (profileLogging) {
+                simThread->setProfileLog(&profileLog);
+            }
+            if (!pagePath.empty()) {
+                sparseWorld.reset(new SparseWorld());
+                if (sparseWorld->openPageFile(pagePath)) {
+                    worldWindow.reset(new WorldWindow(*sparseWorld, simThread->simulation(), 0, 0));
+                } else {
+                    DEBUG_ERROR(("can not create page file " + pagePath).c_str());
+                    sparseWorld.reset();
+                }
+            }
+            extraProfileTitle = "SIMULATION";
+            simThread->replay(replaying.get());
+            fixedStep = 0.0;
+            simThread->start();
         }
 
-        if (remainingMass <= 0.0) return;
+        return true;
+    }
 
-        // up
-        if (map[y - 1][x] == AIR || map[y - 1][x] == WATER) {
-            flow = remainingMass - calcFlow(remainingMass + mass[y - 1][x]);
-            if (flow > minFlow) {
-                flow *= 0.5;
-            }
-            flow = constrain(flow, 0, std::min(maxSpeed, remainingMass));
+    // cell and mass textures of the viewport on units 1 and 2, the palette as uniforms of the material shader
+    void createMaterialTextures() {
+        static_assert(Materials::COUNT <= 16, "material.fsh has a palette of 16 colors");
+        viewIds.assign(static_cast<size_t>(viewWidth) * viewHeight, Simulation::AIR);
+        viewMasses.assign(static_cast<size_t>(viewWidth) * viewHeight, 0);
+        GLuint* textures[2] = {&cellTexture, &massTexture};
+        const uint8_t* data[2] = {viewIds.data(), viewMasses.data()};
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (int32_t i = 0; i < 2; i ++) {
+            glGenTextures(1, textures[i]);
+            glActiveTexture(GL_TEXTURE1 + i);
+            glBindTexture(GL_TEXTURE_2D, *textures[i]);
+            // integer textures can not be filtered
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, viewWidth, viewHeight, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, data[i]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        setMaterialUniforms();
+    }
 
-            massBuffer[y][x] -= flow;
-            massBuffer[y - 1][x] += flow;
-            remainingMass -= flow;
+    // samplers and palette of material.fsh, again after every shader reload
+    void setMaterialUniforms() {
+        GLfloat colors[16 * 4] = {};
+        for (int32_t i = 0; i < Materials::COUNT; i ++) {
+            colors[i * 4 + 0] = Materials::table[i].r / 255.0f;
+            colors[i * 4 + 1] = Materials::table[i].g / 255.0f;
+            colors[i * 4 + 2] = Materials::table[i].b / 255.0f;
+            colors[i * 4 + 3] = Materials::table[i].a / 255.0f;
         }
+        glUniform1i(glGetUniformLocation(shader, "cells"), 1);
+        glUniform1i(glGetUniformLocation(shader, "masses"), 2);
+        glUniform4fv(glGetUniformLocation(shader, "palette"), 16, colors);
+        glUniform1i(glGetUniformLocation(shader, "paletteSize"), Materials::COUNT);
+        glUniform1ui(glGetUniformLocation(shader, "waterID"), Simulation::WATER);
     }
-public:
-    const uint32_t mapWidth = 80 * 2;
-    const uint32_t mapHeight = 60 * 2;
 
-    bool onCreate() override {
-        windowTitle = "Sand Simulator";
-        map = std::vector<std::vector<CellID>>(mapHeight);
-        mapBuffer = std::vector<std::vector<CellID>>(mapHeight);
-        mass = std::vector<std::vector<float>>(mapHeight);
-        massBuffer = std::vector<std::vector<float>>(mapHeight);
-        for (int y = 0; y < mapHeight; y ++) {
-            map[y] = std::vector<CellID>(mapWidth);
-            mapBuffer[y] = std::vector<CellID>(mapWidth);
-            mass[y] = std::vector<float>(mapWidth);
-            massBuffer[y] = std::vector<float>(mapWidth);
-            for (int x = 0; x < mapWidth; x ++) {
-                map[y][x] = AIR;
-                if (y == mapHeight - 1 || x == 0 || x == mapWidth - 1) {
-                    map[y][x] = WALL;
+    // upload rect of the viewport to the cell and mass textures
+    void uploadMaterials(const Simulation::Rect& rect) {
+        const uint8_t* data[2] = {viewIds.data(), viewMasses.data()};
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, viewWidth);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, rect.x);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, rect.y);
+        for (int32_t i = 0; i < 2; i ++) {
+            glActiveTexture(GL_TEXTURE1 + i);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x, rect.y, rect.w, rect.h, GL_RED_INTEGER, GL_UNSIGNED_BYTE, data[i]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+
+    // the viewport pixels of the dirty rects of frame, all of them when the camera moved
+    void redrawRects(const SimulationThread::Frame* frame) {
+        redrawn.clear();
+        if (camera != drawnCamera) {
+            redrawn.push_back({0, 0, static_cast<int32_t>(viewWidth), static_cast<int32_t>(viewHeight)});
+            drawnCamera = camera;
+        } else if (frame) {
+            for (const Simulation::Rect& rect : frame->dirty) {
+                Simulation::Rect shown = camera.viewRect(rect);
+                if (shown.w > 0) {
+                    redrawn.push_back(shown);
                 }
-                mapBuffer[y][x] = AIR;
-                mass[y][x] = 0.0;
-                massBuffer[y][x] = 0.0;
             }
         }
-        time = 0.0;
-        tick = false;
+    }
 
+    void onShaderReload() override {
         uTime_loc = glGetUniformLocation(shader, "uTime");
+        if (materialRender) {
+            setMaterialUniforms();
+        }
+    }
 
+    bool onDestroy() override {
+        if (cellTexture) {
+            glDeleteTextures(1, &cellTexture);
+            glDeleteTextures(1, &massTexture);
+        }
+        if (simThread) {
+            simThread->stop();
+        }
+        if (recording.recording()) {
+            if (gpu) {
+                recording.finish(gpu->tickCount(), gpu->stateHash());
+            } else {
+                recording.finish(simThread->simulation().tickCount(), simThread->simulation().stateHash());
+            }
+            if (recording.save(recordPath)) {
+                DEBUG_MSG(("recorded " + std::to_string(recording.events().size()) + " edits to " + recordPath).c_str());
+            } else {
+                DEBUG_ERROR(("can not save recording " + recordPath).c_str());
+            }
+        }
+        if (sparseWorld) {
+            // the page file only holds this session's chunks
+            worldWindow.reset();
+            sparseWorld.reset();
+            remove(pagePath.c_str());
+        }
         return true;
     }
 
-    bool onUpdate(double deltaTime) override {
-        static float uTime = 0.0f;
-        uTime += deltaTime * 0.002;
-        glUniform1f(uTime_loc, uTime);
-        std::cerr << '\r' << uTime << std::flush;
+    bool onFixedUpdate(double /*step*/) override {
+        if (gpu) {
+            // the state before the first tick past the recording is the recorded one
+            if (replaying && lastReplay == SimulationThread::REPLAY_NONE && replayer.finished(gpu->tickCount())) {
+                uint64_t hash = gpu->stateHash();
+                reportReplay(hash == replaying->endHash() ? SimulationThread::REPLAY_MATCHED : SimulationThread::REPLAY_DRIFTED, hash);
+            }
+            replayer.apply(*gpu, gpu->tickCount());
+            gpu->tick();
+        }
+        return true;
+    }
 
-        tick = false;
-        time += deltaTime * 250;
+    void save() {
+        if (gpu) {
+            Grid<Cell> cells;
+            gpu->read(cells);
+            if (saveSnapshot(savePath, cells, gpu->tickCount())) {
+                DEBUG_MSG(("saved " + savePath).c_str());
+            } else {
+                DEBUG_ERROR(("can not save " + savePath).c_str());
+            }
+        } else if (simThread) {
+            // written by the simulation thread, reported once it is done
+            simThread->requestSnapshot(savePath);
+        }
+    }
 
+    // step the window a chunk, the worker is stopped while the chunks are swapped
+    void moveWindow(int32_t dx, int32_t dy) {
+        simThread->stop();
+        worldWindow->moveTo(worldWindow->chunkX() + dx, worldWindow->chunkY() + dy);
+        simThread->start();
+        DEBUG_MSG(("window at chunk " + std::to_string(worldWindow->chunkX()) + ", " + std::to_string(worldWindow->chunkY())
+            + ", " + std::to_string(sparseWorld->residentChunks()) + " chunks resident, "
+            + std::to_string(sparseWorld->pagedChunks()) + " paged").c_str());
+    }
 
-        if (time >= 1.0) {
-            tick = true;
-            time = 0.0;
+    void reportReplay(SimulationThread::ReplayState state, uint64_t hash) {
+        if (state == lastReplay) {
+            return;
         }
+        lastReplay = state;
+        if (state == SimulationThread::REPLAY_MATCHED) {
+            DEBUG_MSG("replay finished, the state matches the recording");
+        } else if (state == SimulationThread::REPLAY_DRIFTED) {
+            char message[96];
+            snprintf(message, sizeof(message), "replay FAILED: state %016llx, recorded %016llx",
+                static_cast<unsigned long long>(hash), static_cast<unsigned long long>(replaying->endHash()));
+            DEBUG_ERROR(message);
+        }
+    }
 
-        if (getMouseState(GLFW_MOUSE_BUTTON_RIGHT) == PRESS) {
-            map[mousePosY][mousePosX] = WALL;
-            //tick = true;
+    void reportSnapshot() {
+        SimulationThread::SnapshotState state = simThread->snapshotState();
+        if (state == lastSnapshot) {
+            return;
+        }
+        lastSnapshot = state;
+        if (state == SimulationThread::SNAPSHOT_SAVED) {
+            DEBUG_MSG(("saved " + savePath).c_str());
+        } else if (state == SimulationThread::SNAPSHOT_FAILED) {
+            DEBUG_ERROR(("can not save " + savePath).c_str());
+        }
+    }
+
+    bool onUpdate(double deltaTime) override {
+        static float uTime = 0.0f;
+        uTime += deltaTime * 0.002;
+        glUniform1f(uTime_loc, uTime);
+
+        pickBrush();
+        // right paints walls and middle water with the shape and radius of the left button's brush
+        Brush stroke = brush;
+        bool painting = true;
+        if (replaying) {
+            // the mouse would change what the replay does
+            painting = false;
+        } else if (getMouseState(GLFW_MOUSE_BUTTON_RIGHT) == PRESS) {
+            stroke.material = Simulation::WALL;
         } else if (getMouseState(GLFW_MOUSE_BUTTON_LEFT) == PRESS) {
-            map[mousePosY][mousePosX] = SAND;
-            //tick = true;
+            stroke.mass = brush.material == Simulation::WATER ? 1.0 : 0.0;
         } else if (getMouseState(GLFW_MOUSE_BUTTON_MIDDLE) == PRESS) {
-            map[mousePosY][mousePosX] = WATER;
-            mass[mousePosY][mousePosX] = 1.0;
-            //tick = true;
+            stroke.material = Simulation::WATER;
+            stroke.mass = 1.0;
+        } else {
+            painting = false;
         }
+        int32_t x = mouseCellX();
+        int32_t y = mouseCellY();
+        if (painting) {
+            paint(stroking ? strokeX : x, stroking ? strokeY : y, x, y, stroke);
+        }
+        stroking = painting;
+        strokeX = x;
+        strokeY = y;
 
-        if (tick) {
-            for (int y = 0; y < mapHeight; y ++) {
-                for (int x = 0; x < mapWidth; x ++) {
-                    mapBuffer[y][x] = AIR;
-                    massBuffer[y][x] = mass[y][x];
-                }
-            }
-            for (int y = mapHeight - 1; y >= 0; y --) {
-                for (int x = 0; x < mapWidth; x ++) {
-                    CellID id = map[y][x];
-                    switch (id) {
-                        case AIR: {
-                            break;
-                        }
-                        case WALL: {
-                            update_wall(x, y);
-                            break;
-                        }
-                        case SAND: {
-                            update_sand(x, y);
-                            break;
-                        }
-                        case WATER: {
-                            update_water(x, y);
-                            break;
-                        }
-                    }
-                }
-            }
-            for (int y = 0; y < mapHeight; y ++) {
-                for (int x = 0; x < mapWidth; x ++) {
-                    mass[y][x] = massBuffer[y][x];
-                    if (mapBuffer[y][x] == WALL || mapBuffer[y][x] == SAND) continue;
-                    if (mass[y][x] > minMass) {
-                        mapBuffer[y][x] = WATER;
-                    }
-                }
+        bool saveDown = getKeyState(GLFW_KEY_F5) != RELEASE;
+        if (saveDown && !saveHeld) {
+            save();
+        }
+        saveHeld = saveDown;
+
+        if (worldWindow) {
+            int32_t dx = (getKeyState(GLFW_KEY_D) != RELEASE) - (getKeyState(GLFW_KEY_A) != RELEASE);
+            int32_t dy = (getKeyState(GLFW_KEY_S) != RELEASE) - (getKeyState(GLFW_KEY_W) != RELEASE);
+            bool moveDown = dx != 0 || dy != 0;
+            if (moveDown && !moveHeld) {
+                moveWindow(dx, dy);
             }
+            moveHeld = moveDown;
         }
 
+        ProfileZone zone(&profiler, "draw");
+        if (gpu) {
+            // the frame texture is colored by a compute pass, nothing to upload
+            gpu->draw(frameTexture(), palette, Materials::COUNT);
+            return true;
+        }
 
-        for (int y = 0; y < mapHeight; y ++) {
-            for (int x = 0; x < mapWidth; x ++) {
-                if (tick) {
-                    map[y][x] = mapBuffer[y][x];
+        reportSnapshot();
+        if (simThread) {
+            reportReplay(simThread->replayResult(), simThread->replayStateHash());
+        }
+        moveCamera(deltaTime);
+        const SimulationThread::Frame* frame = simThread->latest();
+        if (frame) {
+            extraProfile = frame->profile;
+            windowTitle = "Sand Simulator - chunks: " + std::to_string(frame->activeChunks) + "/" + std::to_string(frame->chunkCount)
+                + " - ticks/s: " + std::to_string(frame->tickRate);
+            if (materialRender) {
+                idView.setWorld(frame->ids.data(), simThread->width(), simThread->height());
+                massView.setWorld(frame->masses.data(), simThread->width(), simThread->height());
+                for (const Simulation::Rect& rect : frame->dirty) {
+                    idView.update(rect);
+                    massView.update(rect);
                 }
-                CellID id = map[y][x];
-                switch (id) {
-                    case AIR: {
-                        break;
-                    }
-                    case WALL: {
-                        drawPoint({x, y}, {200, 200, 200});
-                        break;
-                    }
-                    case SAND: {
-                        drawPoint({x, y}, {200, 200, 50});
-                        break;
-                    }
-                    case WATER: {
-                        drawPoint({x, y}, {0, 255, 255});
-                        break;
-                    }
+            } else {
+                worldView.setWorld(frame->pixels.data(), simThread->width(), simThread->height());
+                for (const Simulation::Rect& rect : frame->dirty) {
+                    worldView.update(rect);
                 }
             }
         }
+
+        if (materialRender ? !idView.hasWorld() : !worldView.hasWorld()) {
+            return true;
+        }
+        redrawRects(frame);
+        const uint32_t background = Color(0, 0, 0, 0).pixel();
+        for (const Simulation::Rect& shown : redrawn) {
+            if (materialRender) {
+                // the frame itself stays transparent for the overlay, the shader colors the cells
+                idView.draw(camera, viewIds.data(), viewWidth, static_cast<uint8_t>(Simulation::AIR), shown);
+                massView.draw(camera, viewMasses.data(), viewWidth, static_cast<uint8_t>(0), shown);
+                uploadMaterials(shown);
+            } else {
+                worldView.draw(camera, canvas[0], canvas.width(), background, shown);
+                markDirty({shown.x, shown.y, shown.w, shown.h});
+            }
+        }
         return true;
     }
+
+    void moveCamera(double deltaTime) {
+        // half a viewport per second
+        double speed = 0.5 * std::max(viewWidth, viewHeight) * deltaTime;
+        double dx = (getKeyState(GLFW_KEY_RIGHT) != RELEASE) - (getKeyState(GLFW_KEY_LEFT) != RELEASE);
+        double dy = (getKeyState(GLFW_KEY_DOWN) != RELEASE) - (getKeyState(GLFW_KEY_UP) != RELEASE);
+        camera.pan(dx * speed, dy * speed);
+
+        int32_t zoom = (getKeyState(GLFW_KEY_EQUAL) != RELEASE) - (getKeyState(GLFW_KEY_MINUS) != RELEASE);
+        if (zoom != 0 && !zoomHeld) {
+            camera.zoomBy(zoom, mousePosX + 0.5, mousePosY + 0.5);
+        }
+        zoomHeld = zoom != 0;
+        if (getKeyState(GLFW_KEY_HOME) != RELEASE) {
+            resetCamera();
+        }
+    }
 };
 
-int main() {
-    App app;
-    if (app.construct(1280, 720, app.mapWidth, app.mapHeight)) {
-        app.init("./shaders/final.vsh", "./shaders/final.fsh");
+int main(int argc, char** argv) {
+    bool useGpu = false;
+    std::string loadPath;
+    std::string savePath = "world.snap";
+    std::string recordPath;
+    std::string replayPath;
+    std::string pagePath;
+    uint32_t viewWidth = 0;
+    uint32_t viewHeight = 0;
+    std::string profileCsv;
+    std::string profileTrace;
+    bool profile = false;
+    bool materialRender = false;
+    Simulation::WaterModel waterModel = Simulation::WaterModel::MASS;
+    int32_t threads = 1;
+    for (int i = 1; i < argc; i ++) {
+        std::string arg = argv[i];
+        if (arg == "--gpu") {
+            useGpu = true;
+        } else if (arg == "--load" && i + 1 < argc) {
+            loadPath = argv[++ i];
+        } else if (arg == "--save" && i + 1 < argc) {
+            savePath = argv[++ i];
+        } else if (arg == "--record" && i + 1 < argc) {
+            recordPath = argv[++ i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            replayPath = argv[++ i];
+        } else if (arg == "--stream" && i + 1 < argc) {
+            pagePath = argv[++ i];
+        } else if (arg == "--view" && i + 1 < argc) {
+            // WxH
+            unsigned width = 0;
+            unsigned height = 0;
+            if (sscanf(argv[++ i], "%ux%u", &width, &height) == 2) {
+                viewWidth = width;
+                viewHeight = height;
+            }
+        } else if (arg == "--render" && i + 1 < argc) {
+            // rgba or material
+            materialRender = std::string(argv[++ i]) == "material";
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = atoi(argv[++ i]);
+        } else if (arg == "--water-model" && i + 1 < argc) {
+            // mass or pressure
+            waterModel = std::string(argv[++ i]) == "pressure" ? Simulation::WaterModel::PRESSURE : Simulation::WaterModel::MASS;
+        } else if (arg == "--profile") {
+            profile = true;
+        } else if (arg == "--profile-csv" && i + 1 < argc) {
+            profileCsv = argv[++ i];
+        } else if (arg == "--profile-trace" && i + 1 < argc) {
+            profileTrace = argv[++ i];
+        }
+    }
+
+    Simulation world;
+    std::unique_ptr<Recording> replay;
+    if (!replayPath.empty()) {
+        replay.reset(new Recording());
+        if (!replay->load(replayPath, world)) {
+            std::cerr << "can not load recording " << replayPath << std::endl;
+            return 1;
+        }
+        waterModel = replay->waterModel();
+        if (useGpu && replay->mode() != ReplayMode::SERIAL) {
+            std::cerr << "the GPU follows the serial sweep, the recording was made " << replayModeName(replay->mode()) << std::endl;
+            return 1;
+        }
+    } else if (!loadPath.empty() && !loadSnapshot(loadPath, world)) {
+        std::cerr << "can not load snapshot " << loadPath << std::endl;
+        return 1;
+    }
+
+    if (!pagePath.empty() && (useGpu || !recordPath.empty() || !replayPath.empty())) {
+        // moving the window is not an edit a recording or the GPU knows about
+        std::cerr << "--stream can not be combined with --gpu, --record or --replay" << std::endl;
+        return 1;
+    }
+    if (!pagePath.empty() && (world.width() % Simulation::chunkSize != 0 || world.height() % Simulation::chunkSize != 0)) {
+        std::cerr << "a streamed world must be whole " << Simulation::chunkSize << " cell chunks" << std::endl;
+        return 1;
+    }
+
+    if (materialRender && useGpu) {
+        // the GPU simulation colors its own frame texture
+        std::cerr << "--render material can not be combined with --gpu" << std::endl;
+        return 1;
+    }
+
+    if (waterModel == Simulation::WaterModel::PRESSURE && useGpu) {
+        std::cerr << "--water-model pressure can not be combined with --gpu" << std::endl;
+        return 1;
+    }
+
+    App app(useGpu, std::move(world), savePath);
+    if (!pagePath.empty()) {
+        app.stream(pagePath);
+    }
+    if (!recordPath.empty()) {
+        app.record(recordPath);
+    }
+    if (replay) {
+        app.replay(std::move(replay));
+    }
+    app.view(viewWidth, viewHeight);
+    app.renderMaterials(materialRender);
+    app.useWaterModel(waterModel);
+    app.useThreads(threads);
+    app.showProfiler(profile);
+    if (!profileCsv.empty() && !app.profileToCsv(profileCsv)) {
+        std::cerr << "can not write " << profileCsv << std::endl;
+        return 1;
+    }
+    if (!profileTrace.empty()) {
+        app.profileToTrace(profileTrace);
+    }
+    if (app.construct(1280, 720, app.viewWidth, app.viewHeight) &&
+        !app.init("./shaders/final.vsh", materialRender ? "./shaders/material.fsh" : "./shaders/final.fsh")) {
+        return 1;
     }
 
     return 0;
@@ -0,0 +1,600 @@
+/**
+ * @file sand_headless.cpp
+ * @brief Runs the simulation without a window or graphics context
+ * @version 0.1
+ * @date 2026-10-16
+ *
+ * @copyright Copyright (c) 2021
+ *
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+#include "Profiler.hpp"
+#include "Replay.hpp"
+#include "Simulation.hpp"
+#include "Scenes.hpp"
+#include "Snapshot.hpp"
+#include "SparseWorld.hpp"
+
+#if HEADLESS_GPU
+#include "HeadlessGL.hpp"
+#include "GpuSimulation.hpp"
+#endif
+
+namespace {
+
+struct Options {
+    int32_t width = 1024;
+    int32_t height = 1024;
+    Scene scene = Scene::MIXED;
+    uint32_t seed = 1;
+    std::string load;
+    std::string save;
+    SnapshotCompression compression = SnapshotCompression::NONE;
+    std::string record;
+    std::string replay;
+    int32_t pour = 0;
+    int32_t scroll = 0;
+    std::string pageFile = "sand_pages.bin";
+    int32_t resident = 64;
+    bool profile = false;
+    std::string profileCsv;
+    std::string profileTrace;
+    int64_t ticks = 1000;
+    int64_t warmup = 10;
+    int32_t threads = 1;
+    std::string water;
+    bool inPlace = false;
+    Simulation::WaterModel waterModel = Simulation::WaterModel::MASS;
+    std::string backend = "cpu";
+};
+
+void usage(const char* program) {
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --width N      world width (default 1024)\n"
+        "  --height N     world height (default 1024)\n"
+        "  --scene NAME   empty | sand | water | mixed | materials (default mixed)\n"
+        "  --seed N       random seed of the scene (default 1)\n"
+        "  --load FILE    load the world from a snapshot or a binary PPM instead of seeding it\n"
+        "  --save FILE    write a snapshot of the world after the measured ticks\n"
+        "  --compression NAME  none | rle, of the saved snapshot (default none)\n"
+        "  --pour N       edit N random cells near the top into sand or water before every tick (default 0)\n"
+        "  --record FILE  record the world and every edit of the run, with the final state hash\n"
+        "  --replay FILE  start from a recording, replay its edits as fast as possible and\n"
+        "                 check the final state hash; ticks, warmup, the update mode and the\n"
+        "                 water model come from the recording\n"
+        "  --scroll N     after the measured ticks stream the world into a sparse world and\n"
+        "                 walk the simulated window N chunks right and back, the state hash\n"
+        "                 must survive the round trip (width and height multiples of 32)\n"
+        "  --page-file FILE  page file of the sparse world (default sand_pages.bin)\n"
+        "  --resident N   chunks the sparse world keeps in memory before paging (default 64)\n"
+        "  --ticks N      measured ticks (default 1000)\n"
+        "  --warmup N     ticks run before measuring (default 10)\n"
+        "  --threads N    worker threads, more than 1 uses the banded sweep (default 1)\n"
+        "  --water NAME   water kernel: scalar | sse2 | avx2 (default: best the CPU supports)\n"
+        "  --update NAME  buffered | inplace, inplace updates a single grid (default buffered)\n"
+        "  --water-model NAME  mass | pressure, pressure levels connected bodies of water\n"
+        "                 in one pass and only flows water at free surfaces (default mass)\n"
+        "  --profile      print min / avg / p99 per tick of the reset, sweep and commit passes\n"
+        "  --profile-csv FILE    write the pass times of every tick as CSV\n"
+        "  --profile-trace FILE  write the passes of every tick as a Chrome trace\n"
+        "  --backend NAME cpu | gpu | parity, parity ticks the serial CPU sweep and the\n"
+        "                 GPU side by side and stops at the first difference (default cpu)\n",
+        program);
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i ++) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            return false;
+        }
+        if (arg == "--profile") {
+            options.profile = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "missing value for %s\n", arg.c_str());
+            return false;
+        }
+        const char* value = argv[++ i];
+        if (arg == "--width") {
+            options.width = atoi(value);
+        } else if (arg == "--height") {
+            options.height = atoi(value);
+        } else if (arg == "--scene") {
+            if (!parseScene(value, options.scene)) {
+                fprintf(stderr, "unknown scene: %s\n", value);
+                return false;
+            }
+        } else if (arg == "--seed") {
+            options.seed = static_cast<uint32_t>(strtoul(value, nullptr, 10));
+        } else if (arg == "--load") {
+            options.load = value;
+        } else if (arg == "--save") {
+            options.save = value;
+        } else if (arg == "--compression") {
+            std::string compression = value;
+            if (compression != "none" && compression != "rle") {
+                fprintf(stderr, "unknown compression: %s\n", value);
+                return false;
+            }
+            options.compression = compression == "rle" ? SnapshotCompression::RLE : SnapshotCompression::NONE;
+        } else if (arg == "--profile-csv") {
+            options.profileCsv = value;
+        } else if (arg == "--profile-trace") {
+            options.profileTrace = value;
+        } else if (arg == "--pour") {
+            options.pour = atoi(value);
+        } else if (arg == "--scroll") {
+            options.scroll = atoi(value);
+        } else if (arg == "--page-file") {
+            options.pageFile = value;
+        } else if (arg == "--resident") {
+            options.resident = atoi(value);
+        } else if (arg == "--record") {
+            options.record = value;
+        } else if (arg == "--replay") {
+            options.replay = value;
+        } else if (arg == "--ticks") {
+            options.ticks = atoll(value);
+        } else if (arg == "--warmup") {
+            options.warmup = atoll(value);
+        } else if (arg == "--threads") {
+            options.threads = atoi(value);
+        } else if (arg == "--water") {
+            options.water = value;
+        } else if (arg == "--update") {
+            std::string update = value;
+            if (update != "buffered" && update != "inplace") {
+                fprintf(stderr, "unknown update: %s\n", value);
+                return false;
+            }
+            options.inPlace = update == "inplace";
+        } else if (arg == "--water-model") {
+            std::string model = value;
+            if (model != "mass" && model != "pressure") {
+                fprintf(stderr, "unknown water model: %s\n", value);
+                return false;
+            }
+            options.waterModel = model == "pressure" ? Simulation::WaterModel::PRESSURE : Simulation::WaterModel::MASS;
+        } else if (arg == "--backend") {
+            options.backend = value;
+            if (options.backend != "cpu" && options.backend != "gpu" && options.backend != "parity") {
+                fprintf(stderr, "unknown backend: %s\n", value);
+                return false;
+            }
+        } else {
+            fprintf(stderr, "unknown option: %s\n", arg.c_str());
+            return false;
+        }
+    }
+    if (options.width < 3 || options.height < 3 || options.ticks < 1 || options.warmup < 0 || options.threads < 1) {
+        fprintf(stderr, "invalid world size or tick count\n");
+        return false;
+    }
+    if (!options.replay.empty() && (!options.record.empty() || options.pour > 0)) {
+        fprintf(stderr, "a replay can not be recorded or poured into\n");
+        return false;
+    }
+    if (options.waterModel == Simulation::WaterModel::PRESSURE && options.backend != "cpu") {
+        fprintf(stderr, "the GPU backend only has the mass water model\n");
+        return false;
+    }
+    if (options.scroll < 0 || options.resident < 0) {
+        fprintf(stderr, "invalid scroll or resident chunk count\n");
+        return false;
+    }
+    return true;
+}
+
+// peak resident set size in bytes, 0 if unknown
+uint64_t peakRSS() {
+#if defined(__linux__)
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#elif defined(__APPLE__)
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+    return 0;
+#endif
+}
+
+#if HEADLESS_GPU
+// ticks the CPU reference and the GPU in lockstep, returns the exit code
+int runParity(Simulation& sim, GpuSimulation& gpu, const Options& options, const Recording* replay) {
+    Grid<Cell> cells(sim.width(), sim.height());
+    Replayer cpuReplayer(replay);
+    Replayer gpuReplayer(replay);
+    int64_t total = options.warmup + options.ticks;
+    for (int64_t i = 1; i <= total; i ++) {
+        cpuReplayer.apply(sim, sim.tickCount());
+        gpuReplayer.apply(gpu, gpu.tickCount());
+        sim.tick();
+        gpu.tick();
+        gpu.read(cells);
+
+        int64_t cellErrors = 0;
+        int64_t massErrors = 0;
+        for (int32_t y = 0; y < sim.height(); y ++) {
+            for (int32_t x = 0; x < sim.width(); x ++) {
+                const Cell& cell = sim.cells()[y][x];
+                if (cells[y][x].type != cell.type) {
+                    cellErrors ++;
+                }
+                if (cells[y][x].mass != cell.mass) {
+                    massErrors ++;
+                }
+            }
+        }
+        if (cellErrors || massErrors) {
+            printf("parity     FAILED at tick %lld: %lld cells and %lld masses differ\n",
+                static_cast<long long>(i), static_cast<long long>(cellErrors), static_cast<long long>(massErrors));
+            return 1;
+        }
+    }
+    printf("parity     %lld ticks match, bit exact\n", static_cast<long long>(total));
+    printf("state      %016llx\n", static_cast<unsigned long long>(sim.stateHash()));
+    return 0;
+}
+#endif
+
+// walk a window over sim right by chunks and back through a sparse world, returns the exit code
+int runScroll(Simulation& sim, const Options& options) {
+    if (sim.width() % SparseWorld::chunkSize != 0 || sim.height() % SparseWorld::chunkSize != 0) {
+        fprintf(stderr, "--scroll needs a world of whole %d cell chunks\n", SparseWorld::chunkSize);
+        return 1;
+    }
+    uint64_t before = sim.stateHash();
+    SparseWorld world(static_cast<size_t>(options.resident));
+    if (!world.openPageFile(options.pageFile)) {
+        fprintf(stderr, "failed to create %s\n", options.pageFile.c_str());
+        return 1;
+    }
+    WorldWindow window(world, sim, 0, 0);
+
+    size_t stored = 0;
+    size_t resident = 0;
+    size_t paged = 0;
+    size_t residentBytes = 0;
+    size_t pagedBytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int32_t i = 1; i <= options.scroll; i ++) {
+        window.moveTo(i, 0);
+    }
+    stored = world.storedChunks();
+    resident = world.residentChunks();
+    paged = world.pagedChunks();
+    residentBytes = world.residentBytes();
+    pagedBytes = world.pagedBytes();
+    for (int32_t i = options.scroll - 1; i >= 0; i --) {
+        window.moveTo(i, 0);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    remove(options.pageFile.c_str());
+
+    int32_t chunks = (sim.width() / SparseWorld::chunkSize) * (sim.height() / SparseWorld::chunkSize);
+    printf("scroll     %d chunks and back in %.3f s, %.1f us per chunk streamed\n", options.scroll, seconds,
+        seconds * 1e6 / std::max<int64_t>(1, static_cast<int64_t>(options.scroll) * 2 * (sim.height() / SparseWorld::chunkSize)));
+    printf("sparse     %zu of %d chunks stored at the far end, %zu resident (%.1f KiB), %zu paged (%.1f KiB)\n",
+        stored, chunks, resident, residentBytes / 1024.0, paged, pagedBytes / 1024.0);
+    if (world.pageError()) {
+        printf("scroll     FAILED: the page file could not be written or read\n");
+        return 1;
+    }
+    if (sim.stateHash() != before) {
+        printf("scroll     FAILED: state %016llx after the round trip\n", static_cast<unsigned long long>(sim.stateHash()));
+        return 1;
+    }
+    printf("scroll     state survives the round trip\n");
+    return 0;
+}
+
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Simulation sim;
+    std::string source;
+    double loadSeconds = -1.0;
+    Recording replay;
+    if (!options.replay.empty()) {
+        auto loadStart = std::chrono::steady_clock::now();
+        if (!replay.load(options.replay, sim)) {
+            fprintf(stderr, "failed to load recording %s\n", options.replay.c_str());
+            return 1;
+        }
+        loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+        source = options.replay + ", " + std::to_string(replay.events().size()) + " edits";
+        options.warmup = 0;
+        options.ticks = static_cast<int64_t>(replay.endTick() - replay.firstTick());
+        if (options.ticks < 1) {
+            fprintf(stderr, "the recording has no ticks\n");
+            return 1;
+        }
+    } else if (!options.load.empty()) {
+        auto loadStart = std::chrono::steady_clock::now();
+        if (!loadSnapshot(options.load, sim) && !loadScenePPM(options.load, sim)) {
+            fprintf(stderr, "failed to load %s\n", options.load.c_str());
+            return 1;
+        }
+        loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+        source = options.load;
+    } else {
+        sim = Simulation(options.width, options.height);
+        seedScene(sim, options.scene, options.seed);
+        source = std::string(sceneName(options.scene)) + ", seed " + std::to_string(options.seed);
+    }
+
+    sim.setThreads(options.threads);
+    if (!options.water.empty()) {
+        bool found = false;
+        for (Water::Kernel kernel : {Water::SCALAR, Water::SSE2, Water::AVX2}) {
+            if (options.water == Water::kernelName(kernel)) {
+                found = true;
+                if (!sim.setWaterKernel(kernel)) {
+                    fprintf(stderr, "water kernel %s is not supported by this CPU\n", options.water.c_str());
+                    return 1;
+                }
+            }
+        }
+        if (!found) {
+            fprintf(stderr, "unknown water kernel: %s\n", options.water.c_str());
+            return 1;
+        }
+    }
+    sim.setInPlace(options.inPlace);
+    sim.setWaterModel(options.waterModel);
+    if (!options.replay.empty()) {
+        // the state hash only matches in the update mode the run was recorded with
+        bool banded = replay.mode() == ReplayMode::BANDED || replay.mode() == ReplayMode::IN_PLACE_BANDED;
+        sim.setInPlace(replay.mode() == ReplayMode::IN_PLACE || replay.mode() == ReplayMode::IN_PLACE_BANDED);
+        sim.setWaterModel(replay.waterModel());
+        if (replay.waterModel() == Simulation::WaterModel::PRESSURE && options.backend != "cpu") {
+            fprintf(stderr, "the GPU backend only has the mass water model, the recording was made with the pressure model\n");
+            return 1;
+        }
+        if (!banded) {
+            sim.setThreads(1);
+        } else if (options.threads < 2) {
+            sim.setThreads(2);
+        }
+    }
+    const Recording* replayed = options.replay.empty() ? nullptr : &replay;
+
+#if HEADLESS_GPU
+    HeadlessGL context;
+    GpuSimulation gpu;
+    if (options.backend != "cpu") {
+        if (!context.create(4, 3)) {
+            fprintf(stderr, "%s\n", context.error().c_str());
+            return 1;
+        }
+        if (!gpu.create(sim.width(), sim.height())) {
+            fprintf(stderr, "%s\n", gpu.error().c_str());
+            return 1;
+        }
+        gpu.upload(sim);
+        printf("gpu        %s\n", context.renderer().c_str());
+    }
+    if (options.backend == "parity") {
+        // the GPU passes follow the serial sweep over the whole world
+        sim.setThreads(1);
+        sim.setChunkSleeping(false);
+        sim.setInPlace(false);
+        if (replayed && replay.mode() != ReplayMode::SERIAL) {
+            fprintf(stderr, "the GPU follows the serial sweep, the recording was made %s\n", replayModeName(replay.mode()));
+            return 1;
+        }
+        printf("world      %dx%d (%s)\n", sim.width(), sim.height(), source.c_str());
+        return runParity(sim, gpu, options, replayed);
+    }
+#else
+    if (options.backend != "cpu") {
+        fprintf(stderr, "built without the GPU backend\n");
+        return 1;
+    }
+#endif
+    bool onGpu = options.backend == "gpu";
+
+    Recording recording;
+    if (!options.record.empty()) {
+        recording.begin(sim.cells(), sim.tickCount(), onGpu ? ReplayMode::SERIAL : replayMode(sim), sim.waterModel());
+    }
+    Replayer replayer(replayed);
+    std::mt19937 pourRng(options.seed);
+
+    // the stats cover the measured ticks
+    Profiler profiler("simulation", 0, static_cast<int32_t>(std::min<int64_t>(options.ticks, 1 << 16)), 1);
+    ProfileLog profileLog;
+    bool profiling = options.profile || !options.profileCsv.empty() || !options.profileTrace.empty();
+    if (!options.profileCsv.empty() && !profileLog.openCsv(options.profileCsv)) {
+        fprintf(stderr, "failed to create %s\n", options.profileCsv.c_str());
+        return 1;
+    }
+    if (!options.profileTrace.empty()) {
+        profileLog.startTrace();
+    }
+    if (!options.profileCsv.empty() || !options.profileTrace.empty()) {
+        profiler.setLog(&profileLog);
+    }
+    if (profiling) {
+        sim.setProfiler(&profiler);
+    }
+    // not during the warmup
+    profiler.setEnabled(false);
+
+    auto tickCount = [&]() {
+#if HEADLESS_GPU
+        if (onGpu) {
+            return gpu.tickCount();
+        }
+#endif
+        return sim.tickCount();
+    };
+
+    auto edit = [&](int32_t x, int32_t y, Simulation::CellID id, float mass) {
+        if (recording.recording()) {
+            recording.record(tickCount(), x, y, id, mass);
+        }
+#if HEADLESS_GPU
+        if (onGpu) {
+            gpu.set(x, y, id, mass);
+            return;
+        }
+#endif
+        sim.set(x, y, id, mass);
+    };
+
+    auto step = [&]() {
+        ProfileZone zone(profiling ? &profiler : nullptr, "tick");
+        for (int32_t i = 0; i < options.pour; i ++) {
+            int32_t x = 1 + static_cast<int32_t>(pourRng() % (sim.width() - 2));
+            int32_t y = 1 + static_cast<int32_t>(pourRng() % std::max(1, sim.height() / 4));
+            if (pourRng() & 1) {
+                edit(x, y, Simulation::WATER, Simulation::maxMass);
+            } else {
+                edit(x, y, Simulation::SAND, 0.0f);
+            }
+        }
+#if HEADLESS_GPU
+        if (onGpu) {
+            replayer.apply(gpu, gpu.tickCount());
+            gpu.tick();
+            return;
+        }
+#endif
+        replayer.apply(sim, sim.tickCount());
+        sim.tick();
+    };
+
+    for (int64_t i = 0; i < options.warmup; i ++) {
+        step();
+    }
+    profiler.setEnabled(profiling);
+
+    uint64_t activeChunks = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int64_t i = 0; i < options.ticks; i ++) {
+        step();
+        if (profiling) {
+            profiler.endFrame();
+        }
+        activeChunks += sim.activeChunks();
+    }
+#if HEADLESS_GPU
+    if (onGpu) {
+        glFinish();
+    }
+#endif
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    double cells = static_cast<double>(sim.width()) * sim.height();
+
+    printf("world      %dx%d (%s)\n", sim.width(), sim.height(), source.c_str());
+    if (loadSeconds >= 0.0) {
+        printf("load       %.3f s\n", loadSeconds);
+    }
+    if (!onGpu) {
+        printf("threads    %d\n", sim.threads());
+        printf("update     %s\n", sim.inPlace() ? "in place" : "buffered");
+        const char* model = sim.waterModel() == Simulation::WaterModel::PRESSURE ? "pressure model" : "";
+        if (!sim.inPlace()) {
+            printf("water      %s%s%s\n", Water::kernelName(sim.waterKernel()), *model ? ", " : "", model);
+        } else if (*model) {
+            printf("water      %s\n", model);
+        }
+    }
+    printf("ticks      %lld\n", static_cast<long long>(options.ticks));
+    printf("time       %.3f s\n", seconds);
+    printf("ticks/sec  %.2f\n", options.ticks / seconds);
+    printf("ns/cell    %.3f\n", seconds * 1e9 / (cells * options.ticks));
+    if (!onGpu) {
+        printf("chunks     %.1f of %d active per tick, %d in the last tick\n",
+            static_cast<double>(activeChunks) / options.ticks, sim.chunkCount(), sim.activeChunks());
+    }
+    printf("peak RSS   %.1f MiB\n", peakRSS() / (1024.0 * 1024.0));
+    if (options.profile) {
+        printf("profile    %-14s %9s %9s %9s  ms per tick\n", "zone", "avg", "min", "p99");
+        for (const Profiler::Stats& zone : profiler.statistics()) {
+            printf("           %*s%-*s %9.4f %9.4f %9.4f\n", zone.depth * 2, "", 14 - zone.depth * 2, zone.name,
+                zone.avg, zone.min, zone.p99);
+        }
+    }
+    if (!options.profileTrace.empty() && !profileLog.writeTrace(options.profileTrace)) {
+        fprintf(stderr, "failed to write %s\n", options.profileTrace.c_str());
+        return 1;
+    }
+    uint64_t state;
+#if HEADLESS_GPU
+    if (onGpu) {
+        state = gpu.stateHash();
+    } else
+#endif
+    state = sim.stateHash();
+    printf("state      %016llx\n", static_cast<unsigned long long>(state));
+
+    if (!options.record.empty()) {
+        recording.finish(tickCount(), state);
+        if (!recording.save(options.record)) {
+            fprintf(stderr, "failed to save recording %s\n", options.record.c_str());
+            return 1;
+        }
+        printf("recorded   %s, %zu edits, %s\n", options.record.c_str(), recording.events().size(),
+            replayModeName(recording.mode()));
+    }
+    if (replayed) {
+        if (onGpu && replay.mode() != ReplayMode::SERIAL) {
+            printf("replay     recorded %s, the GPU state is not compared\n", replayModeName(replay.mode()));
+        } else if (state != replay.endHash()) {
+            printf("replay     FAILED: recorded state %016llx\n", static_cast<unsigned long long>(replay.endHash()));
+            return 1;
+        } else {
+            printf("replay     state matches the recording\n");
+        }
+    }
+
+    if (options.scroll > 0 && !onGpu && runScroll(sim, options) != 0) {
+        return 1;
+    }
+
+    if (!options.save.empty()) {
+        bool saved;
+#if HEADLESS_GPU
+        if (onGpu) {
+            Grid<Cell> cells(sim.width(), sim.height());
+            gpu.read(cells);
+            saved = saveSnapshot(options.save, cells, gpu.tickCount(), options.compression);
+        } else
+#endif
+        saved = saveSnapshot(options.save, sim, options.compression);
+        if (!saved) {
+            fprintf(stderr, "failed to save %s\n", options.save.c_str());
+            return 1;
+        }
+        printf("saved      %s\n", options.save.c_str());
+    }
+    return 0;
+}